@@ -25,6 +25,8 @@ namespace inet {
 
 Define_Module(LoRaMac);
 
+simsignal_t LoRaMac::macIdleSignal = cComponent::registerSignal("macIdle");
+
 LoRaMac::~LoRaMac()
 {
     cancelAndDelete(endTransmission);
@@ -205,6 +207,8 @@ void LoRaMac::handleWithFsm(cMessage *msg)
 
     EV_INFO << "handling packet with handleWithFsm(): " << fsm << endl;
 
+    int previousState = fsm.getState();
+
     FSMA_Switch(fsm)
     {
 
@@ -341,6 +345,9 @@ void LoRaMac::handleWithFsm(cMessage *msg)
             );
         }
     }
+
+    if (previousState != IDLE && fsm.getState() == IDLE)
+        emit(macIdleSignal, 0);
 }
 
 void LoRaMac::receiveSignal(cComponent *source, simsignal_t signalID, long value, cObject *details)
@@ -133,6 +133,9 @@ class LoRaMac : public MACProtocolBase
 
     cFSM fsm;
 
+    /** Emitted when the state machine returns to IDLE, i.e. when the MAC can take a new frame */
+    static simsignal_t macIdleSignal;
+
   protected:
     /**
      * @name Initialization functions
@@ -16,6 +16,7 @@
 #include "LoRaMotoGWMac.h"
 #include "inet/common/ModuleAccess.h"
 #include "inet/physicallayer/contract/packetlevel/IRadio.h"
+#include "LoRaPhy/LoRaPhyTables.h"
 
 
 namespace inet {
@@ -95,13 +96,7 @@ void LoRaMotoGWMac::handleUpperPacket(cPacket *msg)
         frame->setControlInfo(ctrl);
         sendDown(frame);
         waitingForDC = true;
-        double delta;
-        if(frame->getLoRaSF() == 7) delta = 0.61696;
-        if(frame->getLoRaSF() == 8) delta = 1.23392;
-        if(frame->getLoRaSF() == 9) delta = 2.14016;
-        if(frame->getLoRaSF() == 10) delta = 4.28032;
-        if(frame->getLoRaSF() == 11) delta = 7.24992;
-        if(frame->getLoRaSF() == 12) delta = 14.49984;
+        simtime_t delta = LoRaPhyTables::getGatewayDutyCycleDelta(frame->getLoRaSF());
         scheduleAt(simTime() + delta, dutyCycleTimer);
         GW_forwardedDown++;
     }
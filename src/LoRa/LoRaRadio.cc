@@ -474,29 +474,29 @@ void LoRaRadio::endReception(cMessage *timer)
 // TODO: this would draw twice from the random number generator in isReceptionSuccessful: auto isReceptionSuccessful = medium->isReceptionSuccessful(this, transmission, part);
         auto isReceptionSuccessful = medium->getReceptionDecision(this, radioFrame->getListening(), transmission, part)->isReceptionSuccessful();
         EV_INFO << "Reception ended: " << (isReceptionSuccessful ? "successfully" : "unsuccessfully") << " for " << (IRadioFrame *)radioFrame << " " << IRadioSignal::getSignalPartName(part) << " as " << reception << endl;
-        auto macFrame = medium->receivePacket(this, radioFrame);
+        if(isReceptionSuccessful)
+        {
+            auto macFrame = medium->receivePacket(this, radioFrame);
 
-        auto rxinfo = reception->getCompleteStringRepresentation();
-        auto powerpos = rxinfo.find("power");
-        auto powerp = rxinfo.substr(powerpos);
-        auto powercpos = powerp.find(",");
-        auto powerneq = powerp.substr(8, powercpos);
-        auto power = powerneq.substr(0, powerneq.find(",")-2);
+            auto rxinfo = reception->getCompleteStringRepresentation();
+            auto powerpos = rxinfo.find("power");
+            auto powerp = rxinfo.substr(powerpos);
+            auto powercpos = powerp.find(",");
+            auto powerneq = powerp.substr(8, powercpos);
+            auto power = powerneq.substr(0, powerneq.find(",")-2);
 
-        cMsgPar *powerpar = new cMsgPar("rssi");
-        powerpar->setDoubleValue(math::mW2dBm(atof(power.c_str())));
+            cMsgPar *powerpar = new cMsgPar("rssi");
+            powerpar->setDoubleValue(math::mW2dBm(atof(power.c_str())));
 
-        macFrame->addObject(powerpar);
+            macFrame->addObject(powerpar);
 
-        if(isReceptionSuccessful)
-        {
             emit(LayeredProtocolBase::packetSentToUpperSignal, macFrame);
             sendUp(macFrame);
         }
         else
         {
+            check_and_cast<LoRaMedium *>(medium)->dropPacket(this, radioFrame);
             emit(LoRaRadio::droppedPacket, 0);
-            delete macFrame;
         }
         receptionTimer = nullptr;
     }
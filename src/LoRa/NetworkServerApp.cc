@@ -24,6 +24,11 @@ namespace inet {
 
 Define_Module(NetworkServerApp);
 
+NetworkServerApp::~NetworkServerApp()
+{
+    cancelAndDelete(deduplicationTimer);
+    delete adrPolicy;
+}
 
 void NetworkServerApp::initialize(int stage)
 {
@@ -32,14 +37,31 @@ void NetworkServerApp::initialize(int stage)
         LoRa_ServerPacketReceived = registerSignal("LoRa_ServerPacketReceived");
         localPort = par("localPort");
         destPort = par("destPort");
-        adrMethod = par("adrMethod").stdstringValue();
+        adrPolicy = LoRaADRPolicy::create(par("adrMethod"), par("adrDeviceMargin"));
+        recordPerNodeVectors = par("recordPerNodeVectors");
+
+        deduplicationWindow = par("deduplicationWindow");
+        deduplicationTimerResolution = par("deduplicationTimerResolution");
+        if (deduplicationWindow < 0)
+            throw cRuntimeError("deduplicationWindow must not be negative");
+        if (deduplicationTimerResolution <= 0)
+            throw cRuntimeError("deduplicationTimerResolution must be positive");
+        // Pending windows expire within (now, now + window + resolution], so
+        // this many slots never hold two different ticks at once
+        deduplicationWheel.resize(deduplicationWindow.raw() / deduplicationTimerResolution.raw() + 3);
+        deduplicationTimer = new cMessage("deduplicationTimer");
+        deduplicationLatency.setName("Deduplication latency");
+
+        shardIndex = par("shardIndex");
+        shardRing.build(par("numberOfShards"), par("shardVirtualNodes"));
+        if (shardIndex < 0 || shardIndex >= shardRing.getNumberOfShards())
+            throw cRuntimeError("shardIndex %d out of range for %d shards", shardIndex, shardRing.getNumberOfShards());
     } else if (stage == INITSTAGE_APPLICATION_LAYER) {
         startUDP();
         getSimulation()->getSystemModule()->subscribe("LoRa_AppPacketSent", this);
         evaluateADRinServer = par("evaluateADRinServer");
         collectForwardingStats = true;
         acknowledgePackets = par("acknowledgePackets");
-        adrDeviceMargin = par("adrDeviceMargin");
         receivedRSSI.setName("Received RSSI");
         totalReceivedPackets = 0;
         allReceivedNodes = {};
@@ -78,15 +100,22 @@ void NetworkServerApp::handleMessage(cMessage *msg)
 {
     if (msg->arrivedOn("udpIn")) {
         LoRaMacFrame *frame = check_and_cast<LoRaMacFrame *>(msg);
+        if (shardRing.getShard(frame->getTransmitterAddress()) != shardIndex)
+        {
+            EV_WARN << "Dropping packet from " << frame->getTransmitterAddress() << ", which belongs to another shard" << endl;
+            misroutedPackets++;
+            delete msg;
+            return;
+        }
         if (simTime() >= getSimulation()->getWarmupPeriod())
         {
             totalReceivedPackets++;
         }
         updateKnownNodes(frame);
         processLoraMACPacket(PK(msg));
-    } else if(msg->isSelfMessage())
+    } else if(msg == deduplicationTimer)
     {
-        processScheduledPacket(msg);
+        handleDeduplicationTimer();
     }
 }
 
@@ -104,14 +133,15 @@ void NetworkServerApp::processLoraMACPacket(cPacket *pk)
 void NetworkServerApp::finish()
 {
     recordScalar("LoRa_NS_DER", double(counterUniqueReceivedPackets)/counterOfSentPacketsFromNodes);
-    for(uint i=0;i<knownNodes.size();i++)
+    for(uint i=0;i<knownNodeAddresses.size();i++)
     {
-        delete knownNodes[i].historyAllSNIR;
-        delete knownNodes[i].historyAllRSSI;
-        delete knownNodes[i].receivedSeqNumber;
-        delete knownNodes[i].calculatedSNRmargin;
-        recordScalar("Send ADR for node", knownNodes[i].numberOfSentADRPackets);
-        recordScalar("Send ACK for node", knownNodes[i].numberOfSentACKPackets);
+        knownNode& node = knownNodes[knownNodeAddresses[i]];
+        delete node.historyAllSNIR;
+        delete node.historyAllRSSI;
+        delete node.receivedSeqNumber;
+        delete node.calculatedSNRmargin;
+        recordScalar("Send ADR for node", node.numberOfSentADRPackets);
+        recordScalar("Send ACK for node", node.numberOfSentACKPackets);
     }
     for (std::map<int,int>::iterator it=numReceivedPerNode.begin(); it != numReceivedPerNode.end(); ++it)
     {
@@ -121,9 +151,12 @@ void NetworkServerApp::finish()
 
     receivedRSSI.recordAs("receivedRSSI");
     recordScalar("totalReceivedPackets", totalReceivedPackets);
-    for(uint i=0;i<receivedPackets.size();i++)
+    recordScalar("knownNodes", knownNodes.size());
+    recordScalar("misroutedPackets", misroutedPackets);
+    deduplicationLatency.recordAs("deduplicationLatency");
+    for(auto& it : receivedPackets)
     {
-        delete receivedPackets[i].rcvdPacket;
+        delete it.second->rcvdPacket;
     }
     recordScalar("counterUniqueReceivedPacketsPerSF SF7", counterUniqueReceivedPacketsPerSF[0]);
     recordScalar("counterUniqueReceivedPacketsPerSF SF8", counterUniqueReceivedPacketsPerSF[1]);
@@ -184,34 +217,29 @@ void NetworkServerApp::finish()
     recordScalar("forwardedOnlyNodes", forwardedOnlyNodes.size());
 }
 
+uint64_t NetworkServerApp::getPacketKey(const LoRaMacFrame* pkt) const
+{
+    // DevAddr is 32 bits wide, and so is the sequence number
+    return (pkt->getTransmitterAddress().getInt() << 32) | (uint32_t)pkt->getSequenceNumber();
+}
+
 bool NetworkServerApp::isPacketProcessed(LoRaMacFrame* pkt)
 {
-    for(uint i=0;i<knownNodes.size();i++)
-    {
-        if(knownNodes[i].srcAddr == pkt->getTransmitterAddress())
-        {
-            if(knownNodes[i].lastSeqNoProcessed > pkt->getSequenceNumber()) return true;
-        }
-    }
-    return false;
+    auto it = knownNodes.find(pkt->getTransmitterAddress());
+    return it != knownNodes.end() && it->second.lastSeqNoProcessed > pkt->getSequenceNumber();
 }
 
 void NetworkServerApp::updateKnownNodes(LoRaMacFrame* pkt)
 {
-    bool nodeExist = false;
-    for(uint i=0;i<knownNodes.size();i++)
+    auto it = knownNodes.find(pkt->getTransmitterAddress());
+    if(it != knownNodes.end())
     {
-        if(knownNodes[i].srcAddr == pkt->getTransmitterAddress())
+        if(it->second.lastSeqNoProcessed < pkt->getSequenceNumber())
         {
-            nodeExist = true;
-            if(knownNodes[i].lastSeqNoProcessed < pkt->getSequenceNumber())
-            {
-                knownNodes[i].lastSeqNoProcessed = pkt->getSequenceNumber();
-            }
-            break;
+            it->second.lastSeqNoProcessed = pkt->getSequenceNumber();
         }
     }
-    if(nodeExist == false)
+    else
     {
         knownNode newNode;
         newNode.srcAddr= pkt->getTransmitterAddress();
@@ -219,49 +247,114 @@ void NetworkServerApp::updateKnownNodes(LoRaMacFrame* pkt)
         newNode.framesFromLastADRCommand = 0;
         newNode.numberOfSentADRPackets = 0;
         newNode.numberOfSentACKPackets = 0;
-        newNode.historyAllSNIR = new cOutVector;
-        newNode.historyAllSNIR->setName("Vector of SNIR per node");
-        //newNode.historyAllSNIR->record(pkt->getSNIR());
-        newNode.historyAllSNIR->record(math::fraction2dB(pkt->getSNIR()));
-        newNode.historyAllRSSI = new cOutVector;
-        newNode.historyAllRSSI->setName("Vector of RSSI per node");
-        newNode.historyAllRSSI->record(pkt->getRSSI());
-        newNode.receivedSeqNumber = new cOutVector;
-        newNode.receivedSeqNumber->setName("Received Sequence number");
-        newNode.calculatedSNRmargin = new cOutVector;
-        newNode.calculatedSNRmargin->setName("Calculated SNRmargin in ADR");
-        knownNodes.push_back(newNode);
+        newNode.historyAllSNIR = nullptr;
+        newNode.historyAllRSSI = nullptr;
+        newNode.receivedSeqNumber = nullptr;
+        newNode.calculatedSNRmargin = nullptr;
+        if(recordPerNodeVectors)
+        {
+            newNode.historyAllSNIR = new cOutVector;
+            newNode.historyAllSNIR->setName("Vector of SNIR per node");
+            //newNode.historyAllSNIR->record(pkt->getSNIR());
+            newNode.historyAllSNIR->record(math::fraction2dB(pkt->getSNIR()));
+            newNode.historyAllRSSI = new cOutVector;
+            newNode.historyAllRSSI->setName("Vector of RSSI per node");
+            newNode.historyAllRSSI->record(pkt->getRSSI());
+            newNode.receivedSeqNumber = new cOutVector;
+            newNode.receivedSeqNumber->setName("Received Sequence number");
+            newNode.calculatedSNRmargin = new cOutVector;
+            newNode.calculatedSNRmargin->setName("Calculated SNRmargin in ADR");
+        }
+        knownNodes[newNode.srcAddr] = newNode;
+        knownNodeAddresses.push_back(newNode.srcAddr);
     }
 }
 
 void NetworkServerApp::addPktToProcessingTable(LoRaMacFrame* pkt)
 {
-    bool packetExists = false;
     UDPDataIndication *cInfo = check_and_cast<UDPDataIndication*>(pkt->getControlInfo());
-    for(uint i=0;i<receivedPackets.size();i++)
+    auto it = receivedPackets.find(getPacketKey(pkt));
+    if(it != receivedPackets.end())
     {
-        if(receivedPackets[i].rcvdPacket->getTransmitterAddress() == pkt->getTransmitterAddress() && receivedPackets[i].rcvdPacket->getSequenceNumber() == pkt->getSequenceNumber())
-        {
-            packetExists = true;
-            receivedPackets[i].possibleGateways.emplace_back(cInfo->getSrcAddr(), math::fraction2dB(pkt->getSNIR()), pkt->getRSSI());
-            delete pkt;
-        }
+        it->second->addPossibleGateway(cInfo->getSrcAddr(), math::fraction2dB(pkt->getSNIR()), pkt->getRSSI());
+        delete pkt;
+    }
+    else
+    {
+        receivedPacket *rcvPkt = allocateReceivedPacket();
+        rcvPkt->rcvdPacket = pkt;
+        rcvPkt->firstReception = simTime();
+        rcvPkt->addPossibleGateway(cInfo->getSrcAddr(), math::fraction2dB(pkt->getSNIR()), pkt->getRSSI());
+        receivedPackets[getPacketKey(pkt)] = rcvPkt;
+        scheduleDeduplicationWindow(rcvPkt);
+    }
+}
+
+receivedPacket* NetworkServerApp::allocateReceivedPacket()
+{
+    receivedPacket *rcvPkt;
+    if(freeReceivedPackets.empty())
+    {
+        // a deque never moves its elements, so the pointers stay valid
+        receivedPacketPool.emplace_back();
+        rcvPkt = &receivedPacketPool.back();
     }
-    if(packetExists == false)
+    else
     {
-        receivedPacket rcvPkt;
-        rcvPkt.rcvdPacket = pkt;
-        rcvPkt.endOfWaiting = new cMessage("endOfWaitingWindow");
-        rcvPkt.endOfWaiting->setContextPointer(pkt);
-        rcvPkt.possibleGateways.emplace_back(cInfo->getSrcAddr(), math::fraction2dB(pkt->getSNIR()), pkt->getRSSI());
-        scheduleAt(simTime() + 1.2, rcvPkt.endOfWaiting);
-        receivedPackets.push_back(rcvPkt);
+        rcvPkt = freeReceivedPackets.back();
+        freeReceivedPackets.pop_back();
     }
+    rcvPkt->rcvdPacket = nullptr;
+    rcvPkt->numPossibleGateways = 0;
+    return rcvPkt;
+}
+
+void NetworkServerApp::releaseReceivedPacket(receivedPacket* rcvPkt)
+{
+    freeReceivedPackets.push_back(rcvPkt);
 }
 
-void NetworkServerApp::processScheduledPacket(cMessage* selfMsg)
+simtime_t NetworkServerApp::getDeduplicationTickTime(int64_t tick) const
 {
-    LoRaMacFrame *frame = static_cast<LoRaMacFrame *>(selfMsg->getContextPointer());
+    return SimTime().setRaw(tick * deduplicationTimerResolution.raw());
+}
+
+void NetworkServerApp::scheduleDeduplicationWindow(receivedPacket* rcvPkt)
+{
+    int64_t resolution = deduplicationTimerResolution.raw();
+    int64_t tick = ((simTime() + deduplicationWindow).raw() + resolution - 1) / resolution;
+    std::vector<receivedPacket*>& slot = deduplicationWheel[tick % deduplicationWheel.size()];
+    // The window is fixed, so ticks are pushed in non-decreasing order
+    if(slot.empty())
+    {
+        pendingDeduplicationTicks.push_back(tick);
+    }
+    slot.push_back(rcvPkt);
+    if(!deduplicationTimer->isScheduled())
+    {
+        scheduleAt(getDeduplicationTickTime(pendingDeduplicationTicks.front()), deduplicationTimer);
+    }
+}
+
+void NetworkServerApp::handleDeduplicationTimer()
+{
+    int64_t tick = pendingDeduplicationTicks.front();
+    pendingDeduplicationTicks.pop_front();
+    std::vector<receivedPacket*>& slot = deduplicationWheel[tick % deduplicationWheel.size()];
+    for(uint i=0;i<slot.size();i++)
+    {
+        processScheduledPacket(slot[i]);
+    }
+    slot.clear();
+    if(!pendingDeduplicationTicks.empty())
+    {
+        scheduleAt(getDeduplicationTickTime(pendingDeduplicationTicks.front()), deduplicationTimer);
+    }
+}
+
+void NetworkServerApp::processScheduledPacket(receivedPacket* rcvPkt)
+{
+    LoRaMacFrame *frame = rcvPkt->rcvdPacket;
     if (simTime() >= getSimulation()->getWarmupPeriod())
     {
         counterUniqueReceivedPacketsPerSF[frame->getLoRaSF()-7]++;
@@ -269,30 +362,21 @@ void NetworkServerApp::processScheduledPacket(cMessage* selfMsg)
     L3Address pickedGateway;
     double SNIRinGW = -99999999999;
     double RSSIinGW = -99999999999;
-    int packetNumber;
-    int nodeNumber;
-    for(uint i=0;i<receivedPackets.size();i++)
+    int nodeNumber = frame->getTransmitterAddress().getInt();
+    if (numReceivedPerNode.count(nodeNumber-1)>0)
     {
-        if(receivedPackets[i].rcvdPacket->getTransmitterAddress() == frame->getTransmitterAddress() && receivedPackets[i].rcvdPacket->getSequenceNumber() == frame->getSequenceNumber())
-        {
-            packetNumber = i;
-            nodeNumber = frame->getTransmitterAddress().getInt();
-            if (numReceivedPerNode.count(nodeNumber-1)>0)
-            {
-                ++numReceivedPerNode[nodeNumber-1];
-            } else {
-                numReceivedPerNode[nodeNumber-1] = 1;
-            }
+        ++numReceivedPerNode[nodeNumber-1];
+    } else {
+        numReceivedPerNode[nodeNumber-1] = 1;
+    }
 
-            for(uint j=0;j<receivedPackets[i].possibleGateways.size();j++)
-            {
-                if(SNIRinGW < std::get<1>(receivedPackets[i].possibleGateways[j]))
-                {
-                    RSSIinGW = std::get<2>(receivedPackets[i].possibleGateways[j]);
-                    SNIRinGW = std::get<1>(receivedPackets[i].possibleGateways[j]);
-                    pickedGateway = std::get<0>(receivedPackets[i].possibleGateways[j]);
-                }
-            }
+    for(int j=0;j<rcvPkt->numPossibleGateways;j++)
+    {
+        if(SNIRinGW < rcvPkt->possibleGateways[j].SNIR)
+        {
+            RSSIinGW = rcvPkt->possibleGateways[j].RSSI;
+            SNIRinGW = rcvPkt->possibleGateways[j].SNIR;
+            pickedGateway = rcvPkt->possibleGateways[j].ipAddr;
         }
     }
     emit(LoRa_ServerPacketReceived, true);
@@ -301,6 +385,7 @@ void NetworkServerApp::processScheduledPacket(cMessage* selfMsg)
         counterUniqueReceivedPackets++;
     }
     receivedRSSI.collect(frame->getRSSI());
+    deduplicationLatency.collect(simTime() - rcvPkt->firstReception);
     if(collectForwardingStats)
     {
         LoRaMacFrame *frameCopy = frame->dup();
@@ -315,24 +400,16 @@ void NetworkServerApp::processScheduledPacket(cMessage* selfMsg)
     {
         acknowledgePacket(frame, pickedGateway, SNIRinGW, RSSIinGW);
     }
-    delete receivedPackets[packetNumber].rcvdPacket;
-    delete selfMsg;
-    receivedPackets.erase(receivedPackets.begin()+packetNumber);
+    receivedPackets.erase(getPacketKey(frame));
+    delete frame;
+    releaseReceivedPacket(rcvPkt);
 }
 
 void NetworkServerApp::acknowledgePacket(LoRaMacFrame* pkt, L3Address pickedGateway, double SNIRinGW, double RSSIinGW)
 {
-    int nodeIndex;
-
     LoRaAppPacket *rcvAppPacket = check_and_cast<LoRaAppPacket*>(pkt->decapsulate());
 
-    for(uint i=0;i<knownNodes.size();i++)
-    {
-        if(knownNodes[i].srcAddr == pkt->getTransmitterAddress())
-        {
-            nodeIndex = i;
-        }
-    }
+    knownNode& node = knownNodes[pkt->getTransmitterAddress()];
 
     if(rcvAppPacket->getOptions().getAppACKReq())
     {
@@ -353,7 +430,7 @@ void NetworkServerApp::acknowledgePacket(LoRaMacFrame* pkt, L3Address pickedGate
 
         if(simTime() >= getSimulation()->getWarmupPeriod())
         {
-            knownNodes[nodeIndex].numberOfSentACKPackets++;
+            node.numberOfSentACKPackets++;
         }
 
         LoRaMacFrame *frameToSend = new LoRaMacFrame("ACKPacket");
@@ -416,8 +493,6 @@ void NetworkServerApp::evaluateADR(LoRaMacFrame* pkt, L3Address pickedGateway, d
 {
     bool sendADR = false;
     bool sendADRAckRep = false;
-    double SNRm; //needed for ADR
-    int nodeIndex;
 
     LoRaAppPacket *rcvAppPacket = check_and_cast<LoRaAppPacket*>(pkt->decapsulate());
     if(rcvAppPacket->getOptions().getADRACKReq())
@@ -425,41 +500,23 @@ void NetworkServerApp::evaluateADR(LoRaMacFrame* pkt, L3Address pickedGateway, d
         sendADRAckRep = true;
     }
 
-    for(uint i=0;i<knownNodes.size();i++)
+    auto nodeIt = knownNodes.find(pkt->getTransmitterAddress());
+    if(nodeIt != knownNodes.end())
     {
-        if(knownNodes[i].srcAddr == pkt->getTransmitterAddress())
+        knownNode& node = nodeIt->second;
+        node.adrListSNIR.add(SNIRinGW);
+        if(recordPerNodeVectors)
         {
-            knownNodes[i].adrListSNIR.push_back(SNIRinGW);
-            knownNodes[i].historyAllSNIR->record(SNIRinGW);
-            knownNodes[i].historyAllRSSI->record(RSSIinGW);
-            knownNodes[i].receivedSeqNumber->record(pkt->getSequenceNumber());
-            if(knownNodes[i].adrListSNIR.size() == 20) knownNodes[i].adrListSNIR.pop_front();
-            knownNodes[i].framesFromLastADRCommand++;
-
-            nodeIndex = i;
-
-            if(knownNodes[i].framesFromLastADRCommand == 20)
-            {
-                knownNodes[i].framesFromLastADRCommand = 0;
-                sendADR = true;
-                if(adrMethod == "max")
-                {
-                    SNRm = *max_element(knownNodes[i].adrListSNIR.begin(), knownNodes[i].adrListSNIR.end());
-                }
-                if(adrMethod == "avg")
-                {
-                    double totalSNR = 0;
-                    int numberOfFields = 0;
-                    for (std::list<double>::iterator it=knownNodes[i].adrListSNIR.begin(); it != knownNodes[i].adrListSNIR.end(); ++it)
-                    {
-                        totalSNR+=*it;
-                        numberOfFields++;
-                    }
-                    SNRm = totalSNR/numberOfFields;
-                }
-
-            }
+            node.historyAllSNIR->record(SNIRinGW);
+            node.historyAllRSSI->record(RSSIinGW);
+            node.receivedSeqNumber->record(pkt->getSequenceNumber());
+        }
+        node.framesFromLastADRCommand++;
 
+        if(node.framesFromLastADRCommand == 20)
+        {
+            node.framesFromLastADRCommand = 0;
+            sendADR = true;
         }
     }
 
@@ -470,53 +527,20 @@ void NetworkServerApp::evaluateADR(LoRaMacFrame* pkt, L3Address pickedGateway, d
 
         if(sendADR)
         {
-            double SNRmargin;
-            double requiredSNR;
-            if(pkt->getLoRaSF() == 7) requiredSNR = -7.5;
-            if(pkt->getLoRaSF() == 8) requiredSNR = -10;
-            if(pkt->getLoRaSF() == 9) requiredSNR = -12.5;
-            if(pkt->getLoRaSF() == 10) requiredSNR = -15;
-            if(pkt->getLoRaSF() == 11) requiredSNR = -17.5;
-            if(pkt->getLoRaSF() == 12) requiredSNR = -20;
-
-            SNRmargin = SNRm - requiredSNR - adrDeviceMargin;
-            knownNodes[nodeIndex].calculatedSNRmargin->record(SNRmargin);
-            int Nstep = round(SNRmargin/3);
-            LoRaOptions newOptions;
-
-            // Increase the data rate with each step
-            int calculatedSF = pkt->getLoRaSF();
-            while(Nstep > 0 && calculatedSF > 7)
+            LoRaADRDecision decision = adrPolicy->evaluate(nodeIt->second.adrListSNIR, pkt->getLoRaSF(), pkt->getLoRaTP());
+            if(recordPerNodeVectors)
             {
-                calculatedSF--;
-                Nstep--;
+                nodeIt->second.calculatedSNRmargin->record(decision.SNRmargin);
             }
-
-            // Decrease the Tx power by 3 for each step, until min reached
-            double calculatedPowerdBm = pkt->getLoRaTP();
-            while(Nstep > 0 && calculatedPowerdBm > 2)
-            {
-                calculatedPowerdBm-=3;
-                Nstep--;
-            }
-            if(calculatedPowerdBm < 2) calculatedPowerdBm = 2;
-
-            // Increase the Tx power by 3 for each step, until max reached
-            while(Nstep < 0 && calculatedPowerdBm < 14)
-            {
-                calculatedPowerdBm+=3;
-                Nstep++;
-            }
-            if(calculatedPowerdBm > 14) calculatedPowerdBm = 14;
-
-            newOptions.setLoRaSF(calculatedSF);
-            newOptions.setLoRaTP(calculatedPowerdBm);
+            LoRaOptions newOptions;
+            newOptions.setLoRaSF(decision.loRaSF);
+            newOptions.setLoRaTP(decision.loRaTP);
             mgmtPacket->setOptions(newOptions);
         }
 
-        if(simTime() >= getSimulation()->getWarmupPeriod())
+        if(simTime() >= getSimulation()->getWarmupPeriod() && nodeIt != knownNodes.end())
         {
-            knownNodes[nodeIndex].numberOfSentADRPackets++;
+            nodeIt->second.numberOfSentADRPackets++;
         }
 
         LoRaMacFrame *frameToSend = new LoRaMacFrame("ADRPacket");
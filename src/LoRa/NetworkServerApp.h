@@ -21,6 +21,8 @@
 #include <vector>
 #include <tuple>
 #include <algorithm>
+#include <unordered_map>
+#include <deque>
 #include "inet/common/INETDefs.h"
 
 #include "LoRaMacControlInfo_m.h"
@@ -28,6 +30,8 @@
 #include "inet/applications/base/ApplicationBase.h"
 #include "inet/transportlayer/contract/udp/UDPSocket.h"
 #include "LoRaApp/LoRaAppPacket_m.h"
+#include "NetworkServerShardRing.h"
+#include "LoRaApp/LoRaADRPolicy.h"
 #include <list>
 
 namespace inet {
@@ -40,7 +44,8 @@ public:
     int lastSeqNoProcessed;
     int numberOfSentADRPackets;
     int numberOfSentACKPackets;
-    std::list<double> adrListSNIR;
+    adrSNRHistory adrListSNIR;
+    // only allocated with recordPerNodeVectors
     cOutVector *historyAllSNIR;
     cOutVector *historyAllRSSI;
     cOutVector *receivedSeqNumber;
@@ -53,28 +58,87 @@ public:
     L3Address ipAddr;
 };
 
+#define MAX_GATEWAYS_PER_PACKET 8
+
+class gatewayReception
+{
+public:
+    L3Address ipAddr;
+    double SNIR;
+    double RSSI;
+};
+
 class receivedPacket
 {
 public:
     LoRaMacFrame* rcvdPacket;
-    cMessage* endOfWaiting;
-    std::vector<std::tuple<L3Address, double, double>> possibleGateways; // <address, sinr, rssi>
+    simtime_t firstReception;
+    gatewayReception possibleGateways[MAX_GATEWAYS_PER_PACKET];
+    int numPossibleGateways;
+
+    /**
+     * Adds the reception of a gateway. When all the slots are taken, the
+     * reception replaces the weakest one if it has a better SNIR.
+     */
+    void addPossibleGateway(const L3Address& ipAddr, double SNIR, double RSSI)
+    {
+        int slot = numPossibleGateways;
+        if (numPossibleGateways == MAX_GATEWAYS_PER_PACKET)
+        {
+            slot = 0;
+            for (int i = 1; i < numPossibleGateways; i++)
+                if (possibleGateways[i].SNIR < possibleGateways[slot].SNIR)
+                    slot = i;
+            if (possibleGateways[slot].SNIR >= SNIR)
+                return;
+        }
+        else
+            numPossibleGateways++;
+        possibleGateways[slot].ipAddr = ipAddr;
+        possibleGateways[slot].SNIR = SNIR;
+        possibleGateways[slot].RSSI = RSSI;
+    }
 };
 
 class INET_API NetworkServerApp : public cSimpleModule, cListener
 {
   protected:
-    std::vector<knownNode> knownNodes;
+    std::unordered_map<DevAddr, knownNode> knownNodes;
+    std::vector<DevAddr> knownNodeAddresses;    // in order of first reception, for the scalars
     std::vector<knownGW> knownGateways;
-    std::vector<receivedPacket> receivedPackets;
+    std::unordered_map<uint64_t, receivedPacket*> receivedPackets;  // packets waiting for the copies from other gateways, see getPacketKey()
+    std::deque<receivedPacket> receivedPacketPool;
+    std::vector<receivedPacket*> freeReceivedPackets;
+
+    /**
+     * @name Deduplication window
+     * Windows are closed by a timer wheel: each window expires at the first
+     * tick of deduplicationTimerResolution after its deduplicationWindow has
+     * elapsed, and a single timer is scheduled for the earliest pending tick.
+     */
+    //@{
+    simtime_t deduplicationWindow;
+    simtime_t deduplicationTimerResolution;
+    std::vector<std::vector<receivedPacket*>> deduplicationWheel;
+    std::deque<int64_t> pendingDeduplicationTicks;
+    cMessage *deduplicationTimer = nullptr;
+    cStdDev deduplicationLatency;
+    //@}
+
+    /** @name Sharding */
+    //@{
+    int shardIndex;
+    NetworkServerShardRing shardRing;
+    int misroutedPackets = 0;
+    //@}
     int localPort = -1, destPort = -1;
     std::vector<std::tuple<DevAddr, int>> recvdPackets;
     // state
     UDPSocket socket;
     cMessage *selfMsg = nullptr;
     int totalReceivedPackets;
-    std::string adrMethod;
-    double adrDeviceMargin;
+    LoRaADRPolicy *adrPolicy = nullptr;
+    bool recordPerNodeVectors;
     std::map<int, int> numReceivedPerNode;
 
     std::vector<int> allReceivedNodes;
@@ -84,6 +148,9 @@ class INET_API NetworkServerApp : public cSimpleModule, cListener
     std::vector<int> ACKReqNodes;
     std::vector<int> ACKedNodes;
 
+  public:
+    virtual ~NetworkServerApp();
+
   protected:
     virtual void initialize(int stage) override;
     virtual void handleMessage(cMessage *msg) override;
@@ -92,10 +159,16 @@ class INET_API NetworkServerApp : public cSimpleModule, cListener
     void startUDP();
     void setSocketOptions();
     virtual int numInitStages() const override { return NUM_INIT_STAGES; }
+    uint64_t getPacketKey(const LoRaMacFrame* pkt) const;
     bool isPacketProcessed(LoRaMacFrame* pkt);
     void updateKnownNodes(LoRaMacFrame* pkt);
     void addPktToProcessingTable(LoRaMacFrame* pkt);
-    void processScheduledPacket(cMessage* selfMsg);
+    receivedPacket* allocateReceivedPacket();
+    void releaseReceivedPacket(receivedPacket* rcvPkt);
+    simtime_t getDeduplicationTickTime(int64_t tick) const;
+    void scheduleDeduplicationWindow(receivedPacket* rcvPkt);
+    void handleDeduplicationTimer();
+    void processScheduledPacket(receivedPacket* rcvPkt);
     void evaluateADR(LoRaMacFrame* pkt, L3Address pickedGateway, double SNIRinGW, double RSSIinGW);
     void acknowledgePacket(LoRaMacFrame* pkt, L3Address pickedGateway, double SNIRinGW, double RSSIinGW);
     void forwardingStats(LoRaMacFrame* pkt);
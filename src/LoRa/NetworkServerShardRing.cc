@@ -0,0 +1,60 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include <algorithm>
+#include "NetworkServerShardRing.h"
+
+namespace inet {
+
+uint64_t NetworkServerShardRing::mix(uint64_t value)
+{
+    // splitmix64 finalizer, spreads consecutive addresses over the ring
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+void NetworkServerShardRing::build(int numberOfShards, int virtualNodes)
+{
+    if (numberOfShards < 1)
+        throw cRuntimeError("A shard ring needs at least one shard, got %d", numberOfShards);
+    if (virtualNodes < 1)
+        throw cRuntimeError("A shard ring needs at least one virtual node per shard, got %d", virtualNodes);
+
+    this->numberOfShards = numberOfShards;
+    points.clear();
+    points.reserve(numberOfShards * virtualNodes);
+    for (int shard = 0; shard < numberOfShards; shard++)
+        for (int i = 0; i < virtualNodes; i++)
+            points.push_back(std::make_pair(mix(((uint64_t)shard << 32) | (uint32_t)i), shard));
+    std::sort(points.begin(), points.end());
+}
+
+int NetworkServerShardRing::getShard(const DevAddr& addr) const
+{
+    if (points.empty())
+        throw cRuntimeError("The shard ring has not been built");
+    if (numberOfShards == 1)
+        return 0;
+
+    uint64_t hash = mix(addr.getInt());
+    auto it = std::lower_bound(points.begin(), points.end(), std::make_pair(hash, 0));
+    if (it == points.end())
+        it = points.begin();
+    return it->second;
+}
+
+} //namespace inet
@@ -0,0 +1,55 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __LORANETWORK_NETWORKSERVERSHARDRING_H_
+#define __LORANETWORK_NETWORKSERVERSHARDRING_H_
+
+#include <vector>
+#include <utility>
+#include "inet/common/INETDefs.h"
+
+#include "../misc/DevAddr.h"
+
+namespace inet {
+
+/**
+ * Consistent hashing of end-device addresses onto network server shards.
+ *
+ * Each shard is placed on a 64-bit hash ring at virtualNodes points, and
+ * a device belongs to the shard of the first point at or after the hash of
+ * its DevAddr. Gateways and network servers built with the same number of
+ * shards and virtual nodes agree on the owner of every device, and adding
+ * a shard only moves about 1/numberOfShards of the devices.
+ */
+class INET_API NetworkServerShardRing
+{
+  protected:
+    std::vector<std::pair<uint64_t, int>> points;    // <hash, shard>, sorted by hash
+    int numberOfShards = 0;
+
+  protected:
+    static uint64_t mix(uint64_t value);
+
+  public:
+    NetworkServerShardRing() {}
+    NetworkServerShardRing(int numberOfShards, int virtualNodes) { build(numberOfShards, virtualNodes); }
+
+    void build(int numberOfShards, int virtualNodes);
+    int getNumberOfShards() const { return numberOfShards; }
+    int getShard(const DevAddr& addr) const;
+};
+
+} //namespace inet
+#endif
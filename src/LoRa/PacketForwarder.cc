@@ -62,6 +62,12 @@ void PacketForwarder::startUDP()
             EV << "Got destination address: " << token << endl;
         destAddresses.push_back(result);
     }
+
+    if (!destAddresses.empty())
+    {
+        shardRing.build(destAddresses.size(), par("shardVirtualNodes"));
+        forwardedPacketsPerShard.assign(destAddresses.size(), 0);
+    }
 }
 
 
@@ -98,12 +104,19 @@ void PacketForwarder::processLoraMACPacket(cPacket *pk)
     double rssi = w_rssi.get()*1000;
     frame->setRSSI(math::mW2dBm(rssi));
     frame->setSNIR(cInfo->getMinSNIR());
-    bool exist = false;
     EV << frame->getTransmitterAddress() << endl;
-    //for (std::vector<nodeEntry>::iterator it = knownNodes.begin() ; it != knownNodes.end(); ++it)
 
-    // FIXME : Identify network server message is destined for.
-    L3Address destAddr = destAddresses[0];
+    if (destAddresses.empty())
+    {
+        delete frame;
+        return;
+    }
+
+    // Each device is served by the network server shard that owns its address
+    int shard = shardRing.getShard(frame->getTransmitterAddress());
+    L3Address destAddr = destAddresses[shard];
+    if (simTime() >= getSimulation()->getWarmupPeriod())
+        forwardedPacketsPerShard[shard]++;
     if (frame->getControlInfo())
        delete frame->removeControlInfo();
 
@@ -140,6 +153,11 @@ void PacketForwarder::receiveSignal(cComponent *source, simsignal_t signalID, lo
 void PacketForwarder::finish()
 {
     recordScalar("LoRa_GW_DER", double(counterOfReceivedPackets)/counterOfSentPacketsFromNodes);
+    for (uint i = 0; i < forwardedPacketsPerShard.size(); i++)
+    {
+        const std::string stringScalar = "forwardedPacketsToShard " + std::to_string(i);
+        recordScalar(stringScalar.c_str(), forwardedPacketsPerShard[i]);
+    }
 }
 
 
@@ -25,13 +25,16 @@
 #include "LoRaMacFrame_m.h"
 #include "inet/applications/base/ApplicationBase.h"
 #include "inet/transportlayer/contract/udp/UDPSocket.h"
+#include "NetworkServerShardRing.h"
 
 namespace inet {
 
 class INET_API PacketForwarder : public cSimpleModule, public cListener
 {
   protected:
-    std::vector<L3Address> destAddresses;
+    std::vector<L3Address> destAddresses;   // one network server shard per address
+    NetworkServerShardRing shardRing;
+    std::vector<int> forwardedPacketsPerShard;
     int localPort = -1, destPort = -1;
     // state
     UDPSocket socket;
@@ -0,0 +1,73 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "LoRaADRPolicy.h"
+
+namespace inet {
+
+LoRaADRPolicy::LoRaADRPolicy(double deviceMargin) :
+    deviceMargin(deviceMargin)
+{
+    // Demodulation floor of every SF, 2.5 dB apart
+    for (int i = 0; i < ADR_NUMBER_OF_SFS; i++)
+        requiredSNR[i] = -7.5 - 2.5 * i;
+
+    for (int i = 0; i < ADR_NUMBER_OF_SFS; i++)
+        for (int steps = 0; steps < ADR_NUMBER_OF_SFS; steps++)
+            sfAfterSteps[i][steps] = std::max(ADR_MIN_SF, ADR_MIN_SF + i - steps);
+}
+
+LoRaADRPolicy *LoRaADRPolicy::create(const char *adrMethod, double deviceMargin)
+{
+    if (!strcmp(adrMethod, "max"))
+        return new LoRaMaxADRPolicy(deviceMargin);
+    if (!strcmp(adrMethod, "avg"))
+        return new LoRaAvgADRPolicy(deviceMargin);
+    throw cRuntimeError("Unknown ADR method '%s'", adrMethod);
+}
+
+LoRaADRDecision LoRaADRPolicy::evaluate(const adrSNRHistory& history, int loRaSF, double loRaTP) const
+{
+    if (loRaSF < ADR_MIN_SF || loRaSF > ADR_MAX_SF)
+        throw cRuntimeError("No ADR required SNR for SF%d", loRaSF);
+
+    LoRaADRDecision decision;
+    decision.SNRmargin = getSNRm(history) - requiredSNR[loRaSF - ADR_MIN_SF] - deviceMargin;
+    int steps = round(decision.SNRmargin / 3);
+
+    // Increase the data rate with each step, then decrease the Tx power by
+    // 3 for each remaining step, until min reached
+    if (steps > 0)
+    {
+        decision.loRaSF = sfAfterSteps[loRaSF - ADR_MIN_SF][std::min(steps, ADR_NUMBER_OF_SFS - 1)];
+        steps -= loRaSF - decision.loRaSF;
+        decision.loRaTP = std::max((double)ADR_MIN_TP, loRaTP - 3 * steps);
+    }
+    // Increase the Tx power by 3 for each step, until max reached
+    else
+    {
+        decision.loRaSF = loRaSF;
+        decision.loRaTP = std::max((double)ADR_MIN_TP, loRaTP) - 3 * steps;
+    }
+    decision.loRaTP = std::min((double)ADR_MAX_TP, decision.loRaTP);
+    return decision;
+}
+
+} //namespace inet
@@ -0,0 +1,149 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+
+#ifndef __LORA_OMNET_LORAADRPOLICY_H_
+#define __LORA_OMNET_LORAADRPOLICY_H_
+
+#include <omnetpp.h>
+
+#include "inet/common/INETDefs.h"
+
+using namespace omnetpp;
+
+namespace inet {
+
+#define ADR_SNR_HISTORY_SIZE 20
+
+/**
+ * The last ADR_SNR_HISTORY_SIZE SNIR samples of a node, in an inline ring
+ * buffer. The running sum gives the average in O(1), and a monotonic deque
+ * of sample indices (decreasing SNIR from front to back) gives the maximum
+ * in O(1).
+ */
+class adrSNRHistory
+{
+    protected:
+        double samples[ADR_SNR_HISTORY_SIZE];
+        unsigned long count = 0;    // samples ever added, the ring index is count % size
+        double sum = 0;
+        unsigned long maxIndices[ADR_SNR_HISTORY_SIZE];
+        int maxHead = 0;
+        int maxSize = 0;
+
+    public:
+        void add(double SNIR)
+        {
+            if (count >= ADR_SNR_HISTORY_SIZE)
+                sum -= samples[count % ADR_SNR_HISTORY_SIZE];
+            samples[count % ADR_SNR_HISTORY_SIZE] = SNIR;
+            sum += SNIR;
+
+            // Drop the maximum candidate that leaves the window, and the ones
+            // the new sample dominates
+            if (maxSize > 0 && maxIndices[maxHead] + ADR_SNR_HISTORY_SIZE <= count)
+            {
+                maxHead = (maxHead + 1) % ADR_SNR_HISTORY_SIZE;
+                maxSize--;
+            }
+            while (maxSize > 0 && samples[maxIndices[(maxHead + maxSize - 1) % ADR_SNR_HISTORY_SIZE] % ADR_SNR_HISTORY_SIZE] <= SNIR)
+                maxSize--;
+            maxIndices[(maxHead + maxSize) % ADR_SNR_HISTORY_SIZE] = count;
+            maxSize++;
+            count++;
+        }
+        int size() const { return count < ADR_SNR_HISTORY_SIZE ? count : ADR_SNR_HISTORY_SIZE; }
+        double getMax() const { return samples[maxIndices[maxHead] % ADR_SNR_HISTORY_SIZE]; }
+        double getAverage() const { return sum / size(); }
+};
+
+#define ADR_MIN_SF 7
+#define ADR_MAX_SF 12
+#define ADR_NUMBER_OF_SFS (ADR_MAX_SF - ADR_MIN_SF + 1)
+#define ADR_MIN_TP 2
+#define ADR_MAX_TP 14
+
+/**
+ * Transmission settings chosen by an ADR policy.
+ */
+class LoRaADRDecision
+{
+    public:
+        int loRaSF;
+        double loRaTP;
+        double SNRmargin;
+};
+
+/**
+ * Adaptive data rate policy. One instance is created from the adrMethod
+ * parameter at initialization, so choosing between the SNR estimators is a
+ * virtual call instead of a string comparison on every ADR evaluation. The
+ * policy does not depend on any module, so both the network server and the
+ * nodes can evaluate ADR with it.
+ *
+ * The margin over the SNR required by the current SF is turned into steps
+ * of 3 dB. Each step first lowers the SF down to 7, and then lowers the TP
+ * down to the minimum. Negative steps raise the TP up to the maximum. The
+ * SF part of every (SF, steps) pair is precomputed in a table.
+ */
+class INET_API LoRaADRPolicy
+{
+    protected:
+        double deviceMargin;
+        double requiredSNR[ADR_NUMBER_OF_SFS];
+        // SF reached after 0..ADR_NUMBER_OF_SFS-1 steps from every SF; later
+        // steps all go to the TP
+        int sfAfterSteps[ADR_NUMBER_OF_SFS][ADR_NUMBER_OF_SFS];
+
+    public:
+        LoRaADRPolicy(double deviceMargin);
+        virtual ~LoRaADRPolicy() {}
+
+        /**
+         * Returns a new instance of the policy with the given adrMethod
+         * name ("max" or "avg"). Throws a cRuntimeError if it is unknown.
+         */
+        static LoRaADRPolicy *create(const char *adrMethod, double deviceMargin);
+
+        /** SNR estimate of a node from its recent SNIR samples */
+        virtual double getSNRm(const adrSNRHistory& history) const = 0;
+
+        /** New SF and TP for a node transmitting with loRaSF and loRaTP */
+        LoRaADRDecision evaluate(const adrSNRHistory& history, int loRaSF, double loRaTP) const;
+};
+
+/**
+ * Uses the best of the recent SNIR samples.
+ */
+class INET_API LoRaMaxADRPolicy : public LoRaADRPolicy
+{
+    public:
+        LoRaMaxADRPolicy(double deviceMargin) : LoRaADRPolicy(deviceMargin) {}
+        virtual double getSNRm(const adrSNRHistory& history) const override { return history.getMax(); }
+};
+
+/**
+ * Uses the average of the recent SNIR samples.
+ */
+class INET_API LoRaAvgADRPolicy : public LoRaADRPolicy
+{
+    public:
+        LoRaAvgADRPolicy(double deviceMargin) : LoRaADRPolicy(deviceMargin) {}
+        virtual double getSNRm(const adrSNRHistory& history) const override { return history.getAverage(); }
+};
+
+} //namespace inet
+
+#endif
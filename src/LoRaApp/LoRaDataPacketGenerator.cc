@@ -0,0 +1,96 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "LoRaDataPacketGenerator.h"
+
+namespace inet {
+
+LoRaDataPacketGenerator::LoRaDataPacketGenerator() :
+    rng(nullptr),
+    nodeId(-1),
+    numberOfNodes(0),
+    numberOfDestinations(0),
+    numberOfPacketsPerDestination(0),
+    firstDataInt(0),
+    nextPacket(0)
+{
+}
+
+void LoRaDataPacketGenerator::initialize(cRNG *rng, int nodeId, int numberOfNodes, int numberOfDestinations, int numberOfPacketsPerDestination)
+{
+    this->rng = rng;
+    this->nodeId = nodeId;
+    this->numberOfNodes = numberOfNodes;
+    this->numberOfPacketsPerDestination = numberOfPacketsPerDestination;
+
+    this->numberOfDestinations = std::max(0, std::min(numberOfDestinations, numberOfNodes - 1));
+
+    displacedSlots.clear();
+    destinations.clear();
+    firstDataInt = 0;
+    // No round until startRound() is called
+    nextPacket = getPacketsPerRound();
+}
+
+void LoRaDataPacketGenerator::startRound(int firstDataInt)
+{
+    this->firstDataInt = firstDataInt;
+    // Each round shuffles the candidates afresh, so only the slots displaced
+    // by this round's draws are ever kept
+    displacedSlots.clear();
+    destinations.clear();
+    if (getPacketsPerRound() > 0)
+        destinations.reserve(numberOfDestinations);
+    nextPacket = 0;
+}
+
+int LoRaDataPacketGenerator::getSlot(int slot) const
+{
+    auto it = displacedSlots.find(slot);
+    return it != displacedSlots.end() ? it->second : slot;
+}
+
+int LoRaDataPacketGenerator::drawDestination()
+{
+    int drawn = destinations.size();
+    int r = intuniform(rng, drawn, numberOfNodes - 2);
+    int candidate = getSlot(r);
+    displacedSlots[r] = getSlot(drawn);
+    displacedSlots.erase(drawn);
+    // Candidates skip the node's own id
+    return candidate < nodeId ? candidate : candidate + 1;
+}
+
+void LoRaDataPacketGenerator::next(int& destination, int& dataInt)
+{
+    if (!hasNext())
+        throw cRuntimeError("No more data packets in this round");
+
+    // Packets are sent destination by destination, numberOfPacketsPerDestination times
+    int k = nextPacket / numberOfDestinations;
+    int j = nextPacket % numberOfDestinations;
+
+    // Draw destinations only when they are first needed
+    if (j == (int)destinations.size())
+        destinations.push_back(drawDestination());
+
+    destination = destinations[j];
+    // The k-th packet to each destination has always been numbered currDataInt+k,
+    // with currDataInt itself increasing by one after each k
+    dataInt = firstDataInt + 2 * k;
+    nextPacket++;
+}
+
+}
@@ -0,0 +1,83 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __LORA_OMNET_LORADATAPACKETGENERATOR_H_
+#define __LORA_OMNET_LORADATAPACKETGENERATOR_H_
+
+#include <omnetpp.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "inet/common/INETDefs.h"
+
+using namespace omnetpp;
+
+namespace inet {
+
+/**
+ * Produces the (destination, dataInt) pairs of a node's data packets on
+ * demand. A round sends numberOfPacketsPerDestination packets to each of
+ * numberOfDestinations distinct destinations; destinations are drawn lazily
+ * with a sparse partial Fisher-Yates shuffle of the other nodes' ids, so
+ * neither the packets nor the list of candidate destinations are
+ * materialised and the state is O(destinations drawn).
+ */
+class INET_API LoRaDataPacketGenerator
+{
+    protected:
+        cRNG *rng;
+        int nodeId;
+        int numberOfNodes;
+        int numberOfDestinations;
+        int numberOfPacketsPerDestination;
+
+        // Sparse partial Fisher-Yates state over the numberOfNodes - 1 other
+        // nodes: slot i holds candidate i unless displacedSlots says otherwise,
+        // and destinations[j] is the j-th destination drawn this round
+        std::unordered_map<int, int> displacedSlots;
+        std::vector<int> destinations;
+
+        int firstDataInt;
+        int nextPacket;
+
+    public:
+        LoRaDataPacketGenerator();
+
+        void initialize(cRNG *rng, int nodeId, int numberOfNodes, int numberOfDestinations, int numberOfPacketsPerDestination);
+
+        /**
+         * Starts a new round of packets, numbered from firstDataInt on, to a
+         * newly drawn set of destinations.
+         */
+        void startRound(int firstDataInt);
+
+        bool hasNext() const { return nextPacket < getPacketsPerRound(); }
+        int getRemaining() const { return getPacketsPerRound() - nextPacket; }
+        int getPacketsPerRound() const { return numberOfDestinations * numberOfPacketsPerDestination; }
+
+        /**
+         * Returns the destination and dataInt of the next packet of the round.
+         */
+        void next(int& destination, int& dataInt);
+
+    protected:
+        int getSlot(int slot) const;
+        int drawDestination();
+};
+
+}
+
+#endif
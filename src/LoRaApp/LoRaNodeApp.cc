@@ -19,23 +19,12 @@
 
 
 #include "inet/mobility/static/StationaryMobility.h"
+#include "LoRaPhy/LoRaPhyTables.h"
 namespace inet {
 
 #define BROADCAST_ADDRESS   16777215
 
-#define NO_FORWARDING                    0  // No forwarding, no routing.
-#define FLOODING_BROADCAST_SINGLE_SF     1  // Forwarding by flooding, no routing.
-#define SMART_BROADCAST_SINGLE_SF        2  // Forwarding by flooding, no routing, single-hop unicast for last hop if neighbour known.
-#define HOP_COUNT_SINGLE_SF              3  // Next hop routing based on single-SF hop count. In case of a tie, select newest route first.
-#define RSSI_SUM_SINGLE_SF               4  // Next hop routing based on single-SF cumulative RSSI. In case of a tie, select newest route first.
-#define RSSI_PROD_SINGLE_SF              5  // Next hop routing based on single-SF multiplicative RSSI. In case of a tie, select newest route first.
-#define ETX_SINGLE_SF                    6  // Next hop routing based on single-SF ETX. In case of a tie, select newest route first.
-#define TIME_ON_AIR_NEWEST_CAD_MULTI_SF 10  // Next hop routing based on multi-SF ToA. In case of a tie, select newest route first.
-#define TIME_ON_AIR_RANDOM_CAD_MULTI_SF 11  // Next hop routing based on multi-SF ToA. In case of a tie, select randomly between drawing routes.
-#define TIME_ON_AIR_HC_CAD_MULTI_SF     12  // Next hop routing based on multi-SF ToA. In case of a tie, select by minimum hop count between drawing routes. In case of a tie, select newest route first.
-#define TIME_ON_AIR_ETX_CAD_MULTI_SF    13  // Next hop routing based on multi-SF ETX-weighted ToA. In case of a tie, select newest route first.
-#define TIME_ON_AIR_FQUEUE_CAD_MULTI_SF 14  // Next hop routing based on multi-SF queue-length-weighted ToA. In case of a tie, select newest route first.
-#define TIME_ON_AIR_RMP1_CAD_MULTI_SF   15  // Next hop routing based on multi-SF ToA. In case of a tie, select newest route first. Randomly use higher SFs than required.
+#define WITHDRAWN_ROUTE_METRIC  -1  // Metric of the routes withdrawn in an incremental routing packet
 
 Define_Module (LoRaNodeApp);
 
@@ -141,6 +130,8 @@ void LoRaNodeApp::initialize(int stage) {
         broadcastForwardedPackets = 0;
         deletedRoutes = 0;
         forwardBufferFull = 0;
+        routingPacketSequenceGaps = 0;
+        macBusyDeferrals = 0;
 
         firstDataPacketTransmissionTime = 0;
         lastDataPacketTransmissionTime = 0;
@@ -190,19 +181,29 @@ void LoRaNodeApp::initialize(int stage) {
 
         //Routing variables
         routingMetric = par("routingMetric");
+        routing = LoRaRoutingMetric::create(routingMetric, numberOfNodes);
+        singleMetricRouting = dynamic_cast<LoRaSingleMetricRouting *>(routing);
+        dualMetricRouting = dynamic_cast<LoRaDualMetricRouting *>(routing);
         routeDiscovery = par("routeDiscovery");
         // Route discovery must be enabled for broadcast-based smart forwarding
-        switch (routingMetric) {
-            case SMART_BROADCAST_SINGLE_SF:
-                routeDiscovery = true;
+        if (routing->requiresRouteDiscovery()) {
+            routeDiscovery = true;
         }
         routingPacketPriority = par("routingPacketPriority");
         ownDataPriority = par("ownDataPriority");
         routeTimeout = par("routeTimeout");
+        // Incremental routing packets are only supported by single-SF metrics
+        incrementalRoutingPackets = singleMetricRouting != nullptr && par("incrementalRoutingPackets").boolValue();
+        fullRoutingPacketInterval = par("fullRoutingPacketInterval");
+        if (fullRoutingPacketInterval < 1)
+            throw cRuntimeError("fullRoutingPacketInterval must be at least 1");
         storeBestRoutesOnly = par("storeBestRouteOnly");
         getRoutesFromDataPackets = par("getRoutesFromDataPackets");
         packetTTL = par("packetTTL");
         stopRoutingAfterDataDone = par("stopRoutingAfterDataDone");
+        terminationCoordinator = dynamic_cast<LoRaTerminationCoordinator *>(findModuleFromPar<cModule>(par("terminationCoordinatorModule"), this));
+        if (terminationCoordinator == nullptr && !sendPacketsContinuously)
+            throw cRuntimeError("A LoRaTerminationCoordinator is required when sendPacketsContinuously is false");
 
         windowSize = std::min(32,(int)math::max(1,par("windowSize"))); //Must be an int between 1 and 32
 
@@ -224,6 +225,8 @@ void LoRaNodeApp::initialize(int stage) {
         //Packet sizes
         dataPacketSize = par("dataPacketDefaultSize");
         routingPacketMaxSize = par("routingPacketMaxSize");
+        routingPacketHeaderSize = par("routingPacketHeaderSize");
+        routingPacketRouteSize = par("routingPacketRouteSize");
 
         // Data packets timing
         timeToNextDataPacketMin = par("timeToNextDataPacketMin");
@@ -239,15 +242,23 @@ void LoRaNodeApp::initialize(int stage) {
 
         neighbourNodes = {};
         knownNodes = {};
-        LoRaPacketsToSend = {};
         LoRaPacketsToForward = {};
         LoRaPacketsForwarded = {};
-        DataPacketsForMe = {};
         ACKedNodes = {};
 
         //Routing table
         singleMetricRoutingTable = {};
+        singleMetricRoutesCount = 0;
         dualMetricRoutingTable = {};
+        dualMetricRoutesCount = 0;
+
+        //Incremental routing packets
+        routingPacketsSinceFullRefresh = 0;
+        advertisedRoutes = {};
+        routingNeighbours = {};
+
+        //ETX windows of the neighbour routes
+        etxWindows = {};
 
         //Node identifier
         nodeId = getContainingNode(this)->getIndex();
@@ -303,6 +314,8 @@ void LoRaNodeApp::initialize(int stage) {
             WATCH(broadcastForwardedPackets);
             WATCH(deletedRoutes);
             WATCH(forwardBufferFull);
+            WATCH(routingPacketSequenceGaps);
+            WATCH(macBusyDeferrals);
 
             WATCH(AppACKReceived);
             WATCH(firstACK);
@@ -322,36 +335,26 @@ void LoRaNodeApp::initialize(int stage) {
             //WATCH_VECTOR(singleMetricRoutingTable);
             //WATCH_VECTOR(dualMetricRoutingTable);
 
-            WATCH_VECTOR(LoRaPacketsToSend);
-            WATCH_VECTOR(LoRaPacketsToForward);
-            WATCH_VECTOR(LoRaPacketsForwarded);
-            WATCH_VECTOR(DataPacketsForMe);
         }
 
         if (numberOfDestinationsPerNode == 0 ) {
             numberOfDestinationsPerNode = numberOfNodes-1;
         }
+        dataPacketGenerator.initialize(getRNG(par("destinationRng")), nodeId, numberOfNodes, numberOfDestinationsPerNode, numberOfPacketsPerDestination);
         generateDataPackets();
 
         // Routing packets timer
         timeToFirstRoutingPacket = math::max(5, par("timeToFirstRoutingPacket"))+getTimeToNextRoutingPacket();
-        switch (routingMetric) {
-            // No routing packets are to be sent
-            case NO_FORWARDING:
-            case FLOODING_BROADCAST_SINGLE_SF:
-            case SMART_BROADCAST_SINGLE_SF:
-                break;
-            // Schedule selfRoutingPackets
-            default:
-                routingPacketsDue = true;
-                nextRoutingPacketTransmissionTime = timeToFirstRoutingPacket;
-                EV << "Time to first routing packet: " << timeToFirstRoutingPacket << endl;
-                break;
+        // Schedule selfRoutingPackets, if the metric keeps a routing table
+        if (routing->getRoutingTable() != LoRaRoutingMetric::NO_ROUTING_TABLE) {
+            routingPacketsDue = true;
+            nextRoutingPacketTransmissionTime = timeToFirstRoutingPacket;
+            EV << "Time to first routing packet: " << timeToFirstRoutingPacket << endl;
         }
 
         // Data packets timer
         timeToFirstDataPacket = math::max(5, par("timeToFirstDataPacket"))+getTimeToNextDataPacket();
-        if (LoRaPacketsToSend.size() > 0) {
+        if (dataPacketGenerator.hasNext()) {
                     dataPacketsDue = true;
                     nextDataPacketTransmissionTime = timeToFirstDataPacket;
                     EV << "Time to first data packet: " << timeToFirstDataPacket << endl;
@@ -359,6 +362,11 @@ void LoRaNodeApp::initialize(int stage) {
 
         selfPacket = new cMessage("selfPacket");
 
+        // Wake up on the MAC returning to IDLE, rather than polling it while busy
+        mac = check_and_cast<LoRaMac *>(getParentModule()->getSubmodule("LoRaNic")->getSubmodule("mac"));
+        mac->subscribe(LoRaMac::macIdleSignal, this);
+        waitingForMacIdle = false;
+
         if (dataPacketsDue || routingPacketsDue) {
 
             if (dataPacketsDue && !routingPacketsDue) {
@@ -456,33 +464,18 @@ void LoRaNodeApp::finish() {
     recordScalar("firstACK", firstACK);
     recordScalar("firstACKSF", firstACKSF);
 
-    recordScalar("dataPacketsNotSent", LoRaPacketsToSend.size());
-    recordScalar("forwardPacketsNotSent", LoRaPacketsToSend.size());
+    recordScalar("dataPacketsNotSent", dataPacketGenerator.getRemaining());
+    recordScalar("forwardPacketsNotSent", dataPacketGenerator.getRemaining());
 
     recordScalar("forwardBufferFull", forwardBufferFull);
+    recordScalar("routingPacketSequenceGaps", routingPacketSequenceGaps);
+    recordScalar("macBusyDeferrals", macBusyDeferrals);
 
-    for (std::vector<LoRaAppPacket>::iterator lbptr = LoRaPacketsToSend.begin();
-            lbptr < LoRaPacketsToSend.end(); lbptr++) {
-        LoRaPacketsToSend.erase(lbptr);
-    }
+    mac->unsubscribe(LoRaMac::macIdleSignal, this);
+    waitingForMacIdle = false;
 
-    for (std::vector<LoRaAppPacket>::iterator lbptr =
-            LoRaPacketsToForward.begin(); lbptr < LoRaPacketsToForward.end();
-            lbptr++) {
-        LoRaPacketsToForward.erase(lbptr);
-    }
-
-    for (std::vector<LoRaAppPacket>::iterator lbptr =
-            LoRaPacketsForwarded.begin(); lbptr < LoRaPacketsForwarded.end();
-            lbptr++) {
-        LoRaPacketsForwarded.erase(lbptr);
-    }
-
-    for (std::vector<LoRaAppPacket>::iterator lbptr =
-            DataPacketsForMe.begin(); lbptr < DataPacketsForMe.end();
-            lbptr++) {
-        DataPacketsForMe.erase(lbptr);
-    }
+    LoRaPacketsToForward.clear();
+    LoRaPacketsForwarded.clear();
 
     recordScalar("dataPacketsForMeLatencyMax", dataPacketsForMeLatency.getMax());
     recordScalar("dataPacketsForMeLatencyMean", dataPacketsForMeLatency.getMean());
@@ -533,8 +526,7 @@ void LoRaNodeApp::handleMessage(cMessage *msg) {
 void LoRaNodeApp::handleSelfMessage(cMessage *msg) {
 
     // Only proceed to send a data packet if the 'mac' module in 'LoRaNic' is IDLE and the warmup period is due
-    LoRaMac *lrmc = (LoRaMac *)getParentModule()->getSubmodule("LoRaNic")->getSubmodule("mac");
-    if (lrmc->fsm.getState() == IDLE ) {
+    if (mac->fsm.getState() == IDLE ) {
 
         simtime_t txDuration = 0;
         simtime_t nextScheduleTime = 0;
@@ -546,7 +538,7 @@ void LoRaNodeApp::handleSelfMessage(cMessage *msg) {
             sendRouting = true;
         }
         // Check if there are data packets to send or forward, and if it is time to send them
-        if ( (LoRaPacketsToSend.size() > 0 || LoRaPacketsToForward.size() > 0 ) && simTime() >= nextDataPacketTransmissionTime ) {
+        if ( (dataPacketGenerator.hasNext() || LoRaPacketsToForward.size() > 0 ) && simTime() >= nextDataPacketTransmissionTime ) {
             sendData = true;
         }
 
@@ -589,7 +581,7 @@ void LoRaNodeApp::handleSelfMessage(cMessage *msg) {
                 // Update next routing packet transmission time
                 nextDataPacketTransmissionTime = simTime() + math::max(getTimeToNextDataPacket().dbl(), txDuration.dbl());
             }
-            if ( LoRaPacketsToSend.size() > 0 || LoRaPacketsToForward.size() > 0 ) {
+            if ( dataPacketGenerator.hasNext() || LoRaPacketsToForward.size() > 0 ) {
                 dataPacketsDue = true;
             }
             else {
@@ -626,29 +618,26 @@ void LoRaNodeApp::handleSelfMessage(cMessage *msg) {
             scheduleAt(nextScheduleTime + 10*simTimeResolution, selfPacket);
         }
 
+        // Stop routing once all nodes are done with their data packets
         if (!sendPacketsContinuously && routingPacketsDue) {
-
-            bool allNodesDone = true;
-
-            for (int i=0; i<numberOfNodes; i++) {
-                LoRaNodeApp *lrndpp = (LoRaNodeApp *) getParentModule()->getParentModule()->getSubmodule("loRaNodes", i)->getSubmodule("LoRaNodeApp");
-                if ( !(lrndpp->lastDataPacketTransmissionTime > 0 && \
-                     // ToDo: maybe too restrictive? If no packets were received at all
-                     // simulation laster until the very end
-                     //lrndpp->lastDataPacketReceptionTime > 0 &&
-                     lrndpp->lastDataPacketTransmissionTime + stopRoutingAfterDataDone < simTime() && \
-                     lrndpp->lastDataPacketReceptionTime + stopRoutingAfterDataDone < simTime() )) {
-                    allNodesDone = false;
-                    break;
-                }
-
-                if (allNodesDone) {
-                    routingPacketsDue = false;
-                }
+            if (terminationCoordinator->isRoutingDone()) {
+                routingPacketsDue = false;
             }
         }
     }
+    // Wait for the MAC to return to IDLE (see receiveSignal()) instead of polling it
     else {
+        waitingForMacIdle = true;
+        macBusyDeferrals++;
+    }
+}
+
+void LoRaNodeApp::receiveSignal(cComponent *source, simsignal_t signalID, long value, cObject *details) {
+    Enter_Method_Silent();
+
+    if (signalID == LoRaMac::macIdleSignal && waitingForMacIdle) {
+        waitingForMacIdle = false;
+        // Add a few simulation time deltas to avoid timing conflicts in the LoRaMac layer
         scheduleAt(simTime() + 10*simTimeResolution, selfPacket);
     }
 }
@@ -727,20 +716,14 @@ void LoRaNodeApp::handleMessageFromLowerLayer(cMessage *msg) {
     if (packet->getSource() == nodeId) {
         receivedDataPacketsFromMe++;
         bubble("I received a LoRa packet originally sent by me!");
-        if (firstDataPacketReceptionTime == 0) {
-            firstDataPacketReceptionTime = simTime();
-        }
-        lastDataPacketReceptionTime = simTime();
+        recordDataPacketReception();
     }
     // Else, check if the packet is for this node (i.e., a packet directly
     // received from the origin or relayed by a neighbour)
     else if (packet->getDestination() == nodeId) {
         bubble("I received a data packet for me!");
         manageReceivedPacketForMe(packet);
-        if (firstDataPacketReceptionTime == 0) {
-            firstDataPacketReceptionTime = simTime();
-        }
-        lastDataPacketReceptionTime = simTime();
+        recordDataPacketReception();
     }
     // Else it can be a routing protocol broadcast message
     else if (packet->getDestination() == BROADCAST_ADDRESS) {
@@ -752,31 +735,40 @@ void LoRaNodeApp::handleMessageFromLowerLayer(cMessage *msg) {
         if (packet->getVia() == BROADCAST_ADDRESS && routeDiscovery == true) {
             bubble("I received a multicast data packet to forward!");
             manageReceivedDataPacketToForward(packet);
-            if (firstDataPacketReceptionTime == 0) {
-                firstDataPacketReceptionTime = simTime();
-            }
-            lastDataPacketReceptionTime = simTime();
+            recordDataPacketReception();
         }
         // or unicast via this node
         else if (packet->getVia() == nodeId) {
             bubble("I received a unicast data packet to forward!");
             manageReceivedDataPacketToForward(packet);
-            if (firstDataPacketReceptionTime == 0) {
-                firstDataPacketReceptionTime = simTime();
-            }
-            lastDataPacketReceptionTime = simTime();
+            recordDataPacketReception();
         }
         // or not, if it's a unicast packet we just happened to receive.
         else {
             bubble("Unicast message not for me!");
             receivedDataPackets++;
             lastDataPacketReceptionTime = simTime();
+            reportDataActivity(false);
         }
     }
 
     delete msg;
 }
 
+void LoRaNodeApp::recordDataPacketReception() {
+    if (firstDataPacketReceptionTime == 0) {
+        firstDataPacketReceptionTime = simTime();
+    }
+    lastDataPacketReceptionTime = simTime();
+    reportDataActivity(false);
+}
+
+void LoRaNodeApp::reportDataActivity(bool transmission) {
+    if (terminationCoordinator != nullptr) {
+        terminationCoordinator->reportDataActivity(nodeId, transmission, stopRoutingAfterDataDone);
+    }
+}
+
 void LoRaNodeApp::manageReceivedRoutingPacket(cMessage *msg) {
 
 
@@ -789,264 +781,180 @@ void LoRaNodeApp::manageReceivedRoutingPacket(cMessage *msg) {
 
         sanitizeRoutingTable();
 
-        switch (routingMetric) {
-
-            // The node performs no forwarding
-            case NO_FORWARDING:
-                bubble("Discarding routing packet as forwarding is disabled");
-                break;
-
-            // Forwarding is broadcast-based
-            case FLOODING_BROADCAST_SINGLE_SF:
-            case SMART_BROADCAST_SINGLE_SF:
-                bubble("Discarding routing packet as forwarding is broadcast-based");
-                break;
-
-            // Single-SF metrics
-            case HOP_COUNT_SINGLE_SF:
-            case RSSI_SUM_SINGLE_SF:
-            case RSSI_PROD_SINGLE_SF:
-            case ETX_SINGLE_SF:
-
-                bubble("Processing routing packet");
-
-                // Add new route to the neighbour node that sent this routing packet...
-                if (!isRouteInSingleMetricRoutingTable(packet->getSource(), packet->getSource()) ) {
-                    EV << "Adding neighbour " << packet->getSource() << endl;
-                    singleMetricRoute newNeighbour;
-                    newNeighbour.id = packet->getSource();
-                    newNeighbour.via = packet->getSource();
-                    newNeighbour.valid = simTime() + routeTimeout;
-                    switch (routingMetric) {
-                        case HOP_COUNT_SINGLE_SF:
-                            newNeighbour.metric = 1;
-                            break;
-                        case RSSI_SUM_SINGLE_SF:
-                        case RSSI_PROD_SINGLE_SF:
-                            newNeighbour.metric = std::abs(packet->getOptions().getRSSI());
-                            break;
-                        case ETX_SINGLE_SF:
-                            newNeighbour.metric = 1;
-                            newNeighbour.window[0] = packet->getDataInt();
-                            // Fill window[1] and beyond, until windowSizeth element, with 0's
-                            for (int i = 1; i<windowSize; i++) {
-                                newNeighbour.window[i] = 0;
-                            }
-                            break;
-                        }
-                    singleMetricRoutingTable.push_back(newNeighbour);
-                }
+        // The node performs no forwarding
+        if (!routing->isForwarding()) {
+            bubble("Discarding routing packet as forwarding is disabled");
+        }
 
-                // ... or refresh route to known neighbour.
-                else {
-                    int routeIndex = getRouteIndexInSingleMetricRoutingTable(packet->getSource(), packet->getSource());
-                    if (routeIndex >= 0) {
-                        singleMetricRoutingTable[routeIndex].valid = simTime() + routeTimeout;
-                        // Besides the route timeout, each metric may need different things to be updated
-                        int metricValue = 1;
-                        switch (routingMetric) {
-                            case RSSI_SUM_SINGLE_SF:
-                            case RSSI_PROD_SINGLE_SF:
-                                singleMetricRoutingTable[routeIndex].metric = std::abs(packet->getOptions().getRSSI());
-                                break;
-                            case ETX_SINGLE_SF:
-                                // Metric must be recalculated and ETX window must be updated
-                                // Calculate the metric based on the window of previously received routing packets and update it
-                                for (int i=0; i<windowSize; i++) {
-                                    metricValue = metricValue + (packet->getDataInt() - (singleMetricRoutingTable[routeIndex].window[i] + i + 1));
-                                }
-                                singleMetricRoutingTable[routeIndex].metric = std::max(1, metricValue);
-                                // Update the window (set nth element to nth-1 element, and 0th element to the current packet DataInt)
-                                for (int i=windowSize-1; i>0; i--) {
-                                    singleMetricRoutingTable[routeIndex].window[i] = singleMetricRoutingTable[routeIndex].window[i-1];
-                                }
-                                singleMetricRoutingTable[routeIndex].window[0] = packet->getDataInt();
-                                break;
-                            default:
-                                break;
-                        }
-                     }
+        // Forwarding is broadcast-based
+        else if (routing->getRoutingTable() == LoRaRoutingMetric::NO_ROUTING_TABLE) {
+            bubble("Discarding routing packet as forwarding is broadcast-based");
+        }
+
+        // Single-SF metrics
+        else if (singleMetricRouting != nullptr) {
+
+            bubble("Processing routing packet");
+
+            // Add new route to the neighbour node that sent this routing packet...
+            if (!isRouteInSingleMetricRoutingTable(packet->getSource(), packet->getSource()) ) {
+                EV << "Adding neighbour " << packet->getSource() << endl;
+                singleMetricRoute newNeighbour;
+                newNeighbour.id = packet->getSource();
+                newNeighbour.via = packet->getSource();
+                newNeighbour.valid = simTime() + routeTimeout;
+                newNeighbour.advertisedSequence = packet->getDataInt();
+                newNeighbour.metric = singleMetricRouting->getNeighbourMetric(packet, 1);
+                if (singleMetricRouting->usesETX()) {
+                    getETXWindow(packet->getSource(), 0).reset(windowSize, packet->getDataInt());
                 }
+                addRouteToSingleMetricRoutingTable(newNeighbour);
+            }
 
-                // Iterate the routes in the incoming packet. Add new ones to the routing table, or update known ones.
-                for (int i = 0; i < packet->getRoutingTableArraySize(); i++) {
-                    LoRaRoute thisRoute = packet->getRoutingTable(i);
-
-                    if (thisRoute.getId() != nodeId) {
-                        // Add new route...
-                        if (!isRouteInSingleMetricRoutingTable(thisRoute.getId(), packet->getSource())) {
-                            EV << "Adding route to node " << thisRoute.getId() << " via " << packet->getSource() << endl;
-
-                            singleMetricRoute newRoute;
-                            newRoute.id = thisRoute.getId();
-                            newRoute.via = packet->getSource();
-                            newRoute.valid = simTime() + routeTimeout;
-                            switch(routingMetric) {
-                            case HOP_COUNT_SINGLE_SF:
-                                newRoute.metric = thisRoute.getPriMetric()+1;
-                                break;
-                            case RSSI_SUM_SINGLE_SF:
-                                newRoute.metric = thisRoute.getPriMetric()+std::abs(packet->getOptions().getRSSI());
-                                break;
-                            case RSSI_PROD_SINGLE_SF:
-                                newRoute.metric = thisRoute.getPriMetric()*std::abs(packet->getOptions().getRSSI());
-                                break;
-                            case ETX_SINGLE_SF:
-                                newRoute.metric = \
-                                    singleMetricRoutingTable[getRouteIndexInSingleMetricRoutingTable(packet->getSource(), packet->getSource())].metric \
-                                    + thisRoute.getPriMetric();
-                                break;
-                            default:
-                                break;
-                            }
-                            singleMetricRoutingTable.push_back(newRoute);
-                        }
+            // ... or refresh route to known neighbour.
+            else {
+                singleMetricRoute *route = getRouteInSingleMetricRoutingTable(packet->getSource(), packet->getSource());
+                if (route != nullptr) {
+                    route->valid = simTime() + routeTimeout;
+                    route->advertisedSequence = packet->getDataInt();
+                    int etx = 1;
+                    if (singleMetricRouting->usesETX()) {
+                        // ETX window must be updated
+                        etxWindow& window = getETXWindow(packet->getSource(), 0);
+                        etx = window.getETX(packet->getDataInt());
+                        window.add(packet->getDataInt());
+                    }
+                    route->metric = singleMetricRouting->getNeighbourMetric(packet, etx);
+                    routeUpdated(*route);
+                 }
+            }
 
-                        // ... or update a known one.
-                        else {
-                            int routeIndex = getRouteIndexInSingleMetricRoutingTable(thisRoute.getId(), packet->getSource());
-                            if (routeIndex >= 0) {
-                                // Update route timeout
-                                singleMetricRoutingTable[routeIndex].valid = simTime() + routeTimeout;
-                                // Besides the route timeout, each metric may need different things to be updated
-                                switch (routingMetric) {
-                                    case HOP_COUNT_SINGLE_SF:
-                                        singleMetricRoutingTable[routeIndex].metric = thisRoute.getPriMetric()+1;
-                                        break;
-                                    case RSSI_SUM_SINGLE_SF:
-                                        singleMetricRoutingTable[routeIndex].metric = thisRoute.getPriMetric()+std::abs(packet->getOptions().getRSSI());
-                                        break;
-                                    case RSSI_PROD_SINGLE_SF:
-                                        singleMetricRoutingTable[routeIndex].metric = thisRoute.getPriMetric()*std::abs(packet->getOptions().getRSSI());
-                                        break;
-                                    case ETX_SINGLE_SF:
-                                        singleMetricRoutingTable[routeIndex].metric = thisRoute.getPriMetric() \
-                                            + singleMetricRoutingTable[getRouteIndexInSingleMetricRoutingTable(packet->getSource(), packet->getSource())].metric;
-                                        break;
-                                    default:
-                                        break;
-                                }
-                            }
-                        }
+            if (incrementalRoutingPackets) {
+                updateRoutingNeighbour(packet);
+            }
+
+            double neighbourMetric = getRouteInSingleMetricRoutingTable(packet->getSource(), packet->getSource())->metric;
+
+            // Iterate the routes in the incoming packet. Add new ones to the routing table, or update known ones.
+            for (int i = 0; i < packet->getRoutingTableArraySize(); i++) {
+                LoRaRoute thisRoute = packet->getRoutingTable(i);
+
+                if (thisRoute.getId() != nodeId) {
+                    // Remove a route the neighbour no longer advertises...
+                    if (thisRoute.getPriMetric() == WITHDRAWN_ROUTE_METRIC) {
+                        EV << "Removing route to node " << thisRoute.getId() << " via " << packet->getSource() << endl;
+                        removeRouteFromSingleMetricRoutingTable(thisRoute.getId(), packet->getSource());
                     }
-                }
-                break;
-
-            // Multi-SF metrics
-            case TIME_ON_AIR_NEWEST_CAD_MULTI_SF:
-            case TIME_ON_AIR_RANDOM_CAD_MULTI_SF:
-            case TIME_ON_AIR_HC_CAD_MULTI_SF:
-            case TIME_ON_AIR_ETX_CAD_MULTI_SF:
-            case TIME_ON_AIR_FQUEUE_CAD_MULTI_SF:
-            case TIME_ON_AIR_RMP1_CAD_MULTI_SF:
-
-                bubble("Processing routing packet");
-
-                // Add new route to the neighbour node that sent this routing packet...
-                if ( !isRouteInDualMetricRoutingTable(packet->getSource(), packet->getSource(), packet->getOptions().getLoRaSF())) {
-                    EV << "Adding neighbour " << packet->getSource() << " with SF " << packet->getOptions().getLoRaSF() << endl;
-                    dualMetricRoute newNeighbour;
-                    newNeighbour.id = packet->getSource();
-                    newNeighbour.via = packet->getSource();
-                    newNeighbour.sf = packet->getOptions().getLoRaSF();
-                    newNeighbour.valid = simTime() + routeTimeout;
-                    newNeighbour.priMetric = pow(2, packet->getOptions().getLoRaSF() - 7);
-                    newNeighbour.secMetric = 1;
-                    switch (routingMetric) {
-                        case TIME_ON_AIR_ETX_CAD_MULTI_SF:
-                            newNeighbour.window[0] = packet->getDataInt();
-                            // Fill window[1] and beyond, until windowSizeth element, with 0's
-                            for (int i = 1; i<windowSize; i++) {
-                                newNeighbour.window[i] = 0;
-                            }
-                            break;
-                        case TIME_ON_AIR_FQUEUE_CAD_MULTI_SF:
-                            newNeighbour.priMetric = newNeighbour.priMetric * ( numberOfNodes/( std::max(numberOfNodes-packet->getBuffer(), numberOfNodes-1)) );
-                            break;
-                        default:
-                            break;
+
+                    // ... add new route...
+                    else if (!isRouteInSingleMetricRoutingTable(thisRoute.getId(), packet->getSource())) {
+                        EV << "Adding route to node " << thisRoute.getId() << " via " << packet->getSource() << endl;
+
+                        singleMetricRoute newRoute;
+                        newRoute.id = thisRoute.getId();
+                        newRoute.via = packet->getSource();
+                        newRoute.valid = simTime() + routeTimeout;
+                        newRoute.advertisedSequence = packet->getDataInt();
+                        newRoute.metric = singleMetricRouting->getRouteMetric(thisRoute.getPriMetric(), packet, neighbourMetric);
+                        addRouteToSingleMetricRoutingTable(newRoute);
                     }
-                    dualMetricRoutingTable.push_back(newNeighbour);
-                }
 
-                // ... or refresh route to known neighbour.
-                else {
-                    int routeIndex = getRouteIndexInDualMetricRoutingTable(packet->getSource(), packet->getSource(), packet->getOptions().getLoRaSF());
-                    if (routeIndex >= 0) {
-                        dualMetricRoutingTable[routeIndex].valid = simTime() + routeTimeout;
-                        // Besides the route timeout, each metric may need different things to be calculated
-                        int metricValue = pow(2, packet->getOptions().getLoRaSF() - 7);
-                        int etx = 1;
-                        switch (routingMetric) {
-                            case TIME_ON_AIR_ETX_CAD_MULTI_SF:
-                                // Metric must be recalculated and ETX window must be updated
-                                // Calculate the metric based on the window of previously received routing packets and update it
-                                for (int i=0; i<windowSize; i++) {
-                                    etx = etx + (packet->getDataInt() - (dualMetricRoutingTable[routeIndex].window[i] + i+1));
-                                }
-                                dualMetricRoutingTable[routeIndex].priMetric = std::max(metricValue, metricValue*etx);
-                                // Update the window (set nth element to nth-1 element, and 0th element to the current packet DataInt)
-                                for (int i=windowSize-1; i>0; i--) {
-                                    dualMetricRoutingTable[routeIndex].window[i] = dualMetricRoutingTable[routeIndex].window[i-1];
-                                }
-                                dualMetricRoutingTable[routeIndex].window[0] = packet->getDataInt();
-                                break;
-                            case TIME_ON_AIR_FQUEUE_CAD_MULTI_SF:
-                                // Metric must be recalculated based on current buffer occupation
-                                dualMetricRoutingTable[routeIndex].priMetric = pow(2, packet->getOptions().getLoRaSF() - 7) * ( numberOfNodes/( std::max(numberOfNodes-packet->getBuffer(), numberOfNodes-1)) );
-                                break;
-                            default:
-                                break;
+                    // ... or update a known one.
+                    else {
+                        singleMetricRoute *route = getRouteInSingleMetricRoutingTable(thisRoute.getId(), packet->getSource());
+                        if (route != nullptr) {
+                            // Update route timeout and metric
+                            route->valid = simTime() + routeTimeout;
+                            route->advertisedSequence = packet->getDataInt();
+                            route->metric = singleMetricRouting->getRouteMetric(thisRoute.getPriMetric(), packet, neighbourMetric);
+                            routeUpdated(*route);
                         }
                     }
                 }
+            }
+        }
 
-                // Iterate the routes in the incoming packet. Add new ones to the routing table, or update known ones.
-                for (int i = 0; i < packet->getRoutingTableArraySize(); i++) {
-                    LoRaRoute thisRoute = packet->getRoutingTable(i);
-
-                    if (thisRoute.getId() != nodeId ) {
-                        // Add a new route...
-                        if ( !isRouteInDualMetricRoutingTable(thisRoute.getId(), packet->getSource(), packet->getOptions().getLoRaSF())) {
-                            EV << "Adding route to node " << thisRoute.getId() << " via " << packet->getSource() << " with SF " << packet->getOptions().getLoRaSF() << endl;
-                            dualMetricRoute newRoute;
-                            newRoute.id = thisRoute.getId();
-                            newRoute.via = packet->getSource();
-                            newRoute.sf = packet->getOptions().getLoRaSF();
-                            newRoute.valid = simTime() + routeTimeout;
-                            newRoute.priMetric = thisRoute.getPriMetric() \
-                                + dualMetricRoutingTable[getRouteIndexInDualMetricRoutingTable(packet->getSource(),  packet->getSource(), packet->getOptions().getLoRaSF())].priMetric;
-                            newRoute.secMetric = thisRoute.getSecMetric() \
-                                + dualMetricRoutingTable[getRouteIndexInDualMetricRoutingTable(packet->getSource(),  packet->getSource(), packet->getOptions().getLoRaSF())].secMetric;
-                            dualMetricRoutingTable.push_back(newRoute);
-                        }
+        // Multi-SF metrics
+        else if (dualMetricRouting != nullptr) {
+
+            bubble("Processing routing packet");
+
+            // Add new route to the neighbour node that sent this routing packet...
+            if ( !isRouteInDualMetricRoutingTable(packet->getSource(), packet->getSource(), packet->getOptions().getLoRaSF())) {
+                EV << "Adding neighbour " << packet->getSource() << " with SF " << packet->getOptions().getLoRaSF() << endl;
+                dualMetricRoute newNeighbour;
+                newNeighbour.id = packet->getSource();
+                newNeighbour.via = packet->getSource();
+                newNeighbour.sf = packet->getOptions().getLoRaSF();
+                newNeighbour.valid = simTime() + routeTimeout;
+                newNeighbour.priMetric = dualMetricRouting->getNeighbourPriMetric(packet, 1);
+                newNeighbour.secMetric = 1;
+                if (dualMetricRouting->usesETX()) {
+                    getETXWindow(packet->getSource(), packet->getOptions().getLoRaSF()).reset(windowSize, packet->getDataInt());
+                }
+                addRouteToDualMetricRoutingTable(newNeighbour);
+            }
+
+            // ... or refresh route to known neighbour.
+            else {
+                dualMetricRoute *route = getRouteInDualMetricRoutingTable(packet->getSource(), packet->getSource(), packet->getOptions().getLoRaSF());
+                if (route != nullptr) {
+                    route->valid = simTime() + routeTimeout;
+                    int etx = 1;
+                    if (dualMetricRouting->usesETX()) {
+                        // ETX window must be updated
+                        etxWindow& window = getETXWindow(packet->getSource(), packet->getOptions().getLoRaSF());
+                        etx = window.getETX(packet->getDataInt());
+                        window.add(packet->getDataInt());
                     }
+                    route->priMetric = dualMetricRouting->getNeighbourPriMetric(packet, etx);
+                    routeUpdated(*route);
+                }
+            }
 
-                    // ... or update a known one.
-                    else {
-                        int routeIndex = getRouteIndexInDualMetricRoutingTable(thisRoute.getId(), packet->getSource(), packet->getOptions().getLoRaSF());
-                        if (routeIndex >= 0) {
-                            dualMetricRoutingTable[routeIndex].valid = simTime() + routeTimeout;
-                            dualMetricRoutingTable[routeIndex].priMetric = thisRoute.getPriMetric() \
-                                + dualMetricRoutingTable[getRouteIndexInDualMetricRoutingTable(packet->getSource(),  packet->getSource(), packet->getOptions().getLoRaSF())].priMetric;
-                            dualMetricRoutingTable[routeIndex].secMetric = thisRoute.getSecMetric() \
-                                + dualMetricRoutingTable[getRouteIndexInDualMetricRoutingTable(packet->getSource(),  packet->getSource(), packet->getOptions().getLoRaSF())].secMetric;
-                        }
+            // Iterate the routes in the incoming packet. Add new ones to the routing table, or update known ones.
+            for (int i = 0; i < packet->getRoutingTableArraySize(); i++) {
+                LoRaRoute thisRoute = packet->getRoutingTable(i);
+
+                if (thisRoute.getId() != nodeId ) {
+                    // Add a new route...
+                    if ( !isRouteInDualMetricRoutingTable(thisRoute.getId(), packet->getSource(), packet->getOptions().getLoRaSF())) {
+                        EV << "Adding route to node " << thisRoute.getId() << " via " << packet->getSource() << " with SF " << packet->getOptions().getLoRaSF() << endl;
+                        const dualMetricRoute *neighbourRoute = getRouteInDualMetricRoutingTable(packet->getSource(),  packet->getSource(), packet->getOptions().getLoRaSF());
+                        dualMetricRoute newRoute;
+                        newRoute.id = thisRoute.getId();
+                        newRoute.via = packet->getSource();
+                        newRoute.sf = packet->getOptions().getLoRaSF();
+                        newRoute.valid = simTime() + routeTimeout;
+                        newRoute.priMetric = thisRoute.getPriMetric() + neighbourRoute->priMetric;
+                        newRoute.secMetric = thisRoute.getSecMetric() + neighbourRoute->secMetric;
+                        addRouteToDualMetricRoutingTable(newRoute);
                     }
-                } // End of multiSF routes for loop.
+                }
 
-                EV << "Routing table size: " << end(dualMetricRoutingTable) - begin(dualMetricRoutingTable) << endl;
-                break;
+                // ... or update a known one.
+                else {
+                    dualMetricRoute *route = getRouteInDualMetricRoutingTable(thisRoute.getId(), packet->getSource(), packet->getOptions().getLoRaSF());
+                    if (route != nullptr) {
+                        const dualMetricRoute *neighbourRoute = getRouteInDualMetricRoutingTable(packet->getSource(),  packet->getSource(), packet->getOptions().getLoRaSF());
+                        route->valid = simTime() + routeTimeout;
+                        route->priMetric = thisRoute.getPriMetric() + neighbourRoute->priMetric;
+                        route->secMetric = thisRoute.getSecMetric() + neighbourRoute->secMetric;
+                        routeUpdated(*route);
+                    }
+                }
+            } // End of multiSF routes for loop.
 
-            default:
-                break;
-        } // End of routingMetric switch
-        routingTableSize.collect(singleMetricRoutingTable.size());
+            EV << "Routing table size: " << dualMetricRoutesCount << endl;
+        }
+        routingTableSize.collect(singleMetricRoutesCount);
     } // End of routing packet type if
 
     EV << "## Routing table at node " << nodeId << "##" << endl;
-    for (int i=0; i<singleMetricRoutingTable.size(); i++) {
-        EV << "Node " << singleMetricRoutingTable[i].id << " via " << singleMetricRoutingTable[i].via << " with cost " << singleMetricRoutingTable[i].metric << endl;
+    for (auto& bucket : singleMetricRoutingTable) {
+        for (auto& route : bucket.second.routes) {
+            EV << "Node " << route.id << " via " << route.via << " with cost " << route.metric << endl;
+        }
     }
 }
 
@@ -1080,7 +988,6 @@ void LoRaNodeApp::manageReceivedDataPacketToForward(cMessage *msg) {
     bool newPacketToForward = false;
 
     LoRaAppPacket *packet = check_and_cast<LoRaAppPacket *>(msg);
-    LoRaAppPacket *dataPacket = packet->dup();
 
     // Check for too old packets with TTL <= 1
     if (packet->getTtl() <= 1) {
@@ -1092,51 +999,45 @@ void LoRaNodeApp::manageReceivedDataPacketToForward(cMessage *msg) {
     else {
         receivedDataPacketsToForwardCorrect++;
 
-        switch (routingMetric) {
-            case NO_FORWARDING:
-                bubble("Discarding packet as forwarding is disabled");
-                break;
-
-            case FLOODING_BROADCAST_SINGLE_SF:
-            case SMART_BROADCAST_SINGLE_SF:
-            case HOP_COUNT_SINGLE_SF:
-            case RSSI_SUM_SINGLE_SF:
-            case RSSI_PROD_SINGLE_SF:
-            case ETX_SINGLE_SF:
-            case TIME_ON_AIR_RMP1_CAD_MULTI_SF:
-            case TIME_ON_AIR_HC_CAD_MULTI_SF:
-            case TIME_ON_AIR_ETX_CAD_MULTI_SF:
-            default:
-                // Check if the packet has already been forwarded
-                if (isPacketForwarded(packet)) {
-                    bubble("This packet has already been forwarded!");
-                    forwardPacketsDuplicateAvoid++;
-                }
-                // Check if the packet is buffered to be forwarded
-                else if (isPacketToBeForwarded(packet)) {
-                    bubble("This packet is already scheduled to be forwarded!");
-                    forwardPacketsDuplicateAvoid++;
-                // A previously-unknown packet has arrived
-                } else {
-                    bubble("Saving packet to forward it later!");
-                    receivedDataPacketsToForwardUnique++;
-
-                    dataPacket->setTtl(packet->getTtl() - 1);
-                    if (packetsToForwardMaxVectorSize == 0 || LoRaPacketsToForward.size()<packetsToForwardMaxVectorSize) {
-                        LoRaPacketsToForward.push_back(*dataPacket);
-                        newPacketToForward = true;
-                    }
-                    else {
-                        forwardBufferFull++;
-                    }
-                }
+        if (!routing->isForwarding()) {
+            bubble("Discarding packet as forwarding is disabled");
+        }
+        // Check if the packet has already been forwarded
+        else if (isPacketForwarded(packet)) {
+            bubble("This packet has already been forwarded!");
+            forwardPacketsDuplicateAvoid++;
+        }
+        // Check if the packet is buffered to be forwarded
+        else if (isPacketToBeForwarded(packet)) {
+            bubble("This packet is already scheduled to be forwarded!");
+            forwardPacketsDuplicateAvoid++;
+        // A previously-unknown packet has arrived
+        } else {
+            bubble("Saving packet to forward it later!");
+            receivedDataPacketsToForwardUnique++;
+
+            if (packetsToForwardMaxVectorSize == 0 || LoRaPacketsToForward.size()<packetsToForwardMaxVectorSize) {
+                LoRaAppPacketEntry entry;
+                entry.msgType = packet->getMsgType();
+                entry.dataInt = packet->getDataInt();
+                entry.source = packet->getSource();
+                entry.destination = packet->getDestination();
+                entry.ttl = packet->getTtl() - 1;
+                entry.byteLength = packet->getByteLength();
+                entry.appACKReq = packet->getOptions().getAppACKReq();
+                entry.departureTime = packet->getDepartureTime();
+                LoRaPacketsToForward.push_back(entry);
+                packetsToForwardKeys.insert(getPacketKey(entry));
+                newPacketToForward = true;
+            }
+            else {
+                forwardBufferFull++;
+            }
         }
 
     }
 
-    delete dataPacket;
-
-    if (newPacketToForward && !selfPacket->isScheduled()) {
+    if (newPacketToForward && !selfPacket->isScheduled() && !waitingForMacIdle) {
 
         simtime_t nextScheduleTime = simTime() + 10*simTimeResolution;
 
@@ -1180,7 +1081,7 @@ void LoRaNodeApp::manageReceivedDataPacketForMe(cMessage *msg) {
     dataPacketsForMeLatency.collect(simTime()-packet->getDepartureTime());
 
     if (isDataPacketForMeUnique(packet)) {
-        DataPacketsForMe.push_back(*packet);
+        dataPacketsForMeKeys.insert(getPacketKey(packet));
         receivedDataPacketsForMeUnique++;
         dataPacketsForMeUniqueLatency.collect(simTime()-packet->getDepartureTime());
     }
@@ -1213,8 +1114,8 @@ simtime_t LoRaNodeApp::sendDataPacket() {
 
     // Send local data packets with a configurable ownDataPriority priority over packets to forward, if there is any
     if (
-            (LoRaPacketsToSend.size() > 0 && bernoulli(ownDataPriority))
-            || (LoRaPacketsToSend.size() > 0 && LoRaPacketsToForward.size() == 0)) {
+            (dataPacketGenerator.hasNext() && bernoulli(ownDataPriority))
+            || (dataPacketGenerator.hasNext() && LoRaPacketsToForward.size() == 0)) {
 
         bubble("Sending a local data packet!");
 
@@ -1225,15 +1126,19 @@ simtime_t LoRaNodeApp::sendDataPacket() {
         fullName += std::to_string(nodeId);
 
 
-        // Get the data from the first packet in the data buffer to send it
-        dataPacket->setMsgType(LoRaPacketsToSend.front().getMsgType());
-        dataPacket->setDataInt(LoRaPacketsToSend.front().getDataInt());
-        dataPacket->setSource(LoRaPacketsToSend.front().getSource());
-        dataPacket->setVia(LoRaPacketsToSend.front().getSource());
-        dataPacket->setDestination(LoRaPacketsToSend.front().getDestination());
-        dataPacket->setTtl(LoRaPacketsToSend.front().getTtl());
-        dataPacket->getOptions().setAppACKReq(LoRaPacketsToSend.front().getOptions().getAppACKReq());
-        dataPacket->setByteLength(LoRaPacketsToSend.front().getByteLength());
+        // Get the destination and sequence number of the next local data packet
+        int destination;
+        int dataInt;
+        dataPacketGenerator.next(destination, dataInt);
+
+        dataPacket->setMsgType(DATA);
+        dataPacket->setDataInt(dataInt);
+        dataPacket->setSource(nodeId);
+        dataPacket->setVia(nodeId);
+        dataPacket->setDestination(destination);
+        dataPacket->setTtl(packetTTL);
+        dataPacket->getOptions().setAppACKReq(requestACKfromApp);
+        dataPacket->setByteLength(dataPacketSize);
         dataPacket->setDepartureTime(simTime());
 
         addName = "Dest";
@@ -1241,14 +1146,13 @@ simtime_t LoRaNodeApp::sendDataPacket() {
         fullName += std::to_string(dataPacket->getDestination());
         dataPacket->setName(fullName.c_str());
 
-        LoRaPacketsToSend.erase(LoRaPacketsToSend.begin());
-
         transmit = true;
 
         sentDataPackets++;
         if (firstDataPacketTransmissionTime == 0)
             firstDataPacketTransmissionTime = simTime();
         lastDataPacketTransmissionTime = simTime();
+        reportDataActivity(true);
     }
 
     // Forward other nodes' packets, if any
@@ -1263,63 +1167,51 @@ simtime_t LoRaNodeApp::sendDataPacket() {
         dataPacket->setName(fullName.c_str());
         fullName += std::to_string(nodeId);
 
-        switch (routingMetric) {
-            case NO_FORWARDING:
-                // This should never happen
-                bubble("Forwarding disabled!");
-                break;
-
-            case FLOODING_BROADCAST_SINGLE_SF:
-            case SMART_BROADCAST_SINGLE_SF:
-            case HOP_COUNT_SINGLE_SF:
-            case RSSI_SUM_SINGLE_SF:
-            case RSSI_PROD_SINGLE_SF:
-            case ETX_SINGLE_SF:
-            case TIME_ON_AIR_NEWEST_CAD_MULTI_SF:
-            case TIME_ON_AIR_RANDOM_CAD_MULTI_SF:
-            case TIME_ON_AIR_HC_CAD_MULTI_SF:
-            case TIME_ON_AIR_ETX_CAD_MULTI_SF:
-            case TIME_ON_AIR_FQUEUE_CAD_MULTI_SF:
-            case TIME_ON_AIR_RMP1_CAD_MULTI_SF:
-            default:
-                while (LoRaPacketsToForward.size() > 0) {
-                    addName = "FWD-";
-                    fullName += addName;
-                    fullName += std::to_string(routingMetric);
-                    addName = "-";
-                    fullName += addName;
-                    dataPacket->setName(fullName.c_str());
-
-                    // Get the data from the first packet in the forwarding buffer to send it
-                    dataPacket->setMsgType(LoRaPacketsToForward.front().getMsgType());
-                    dataPacket->setDataInt(LoRaPacketsToForward.front().getDataInt());
-                    dataPacket->setSource(LoRaPacketsToForward.front().getSource());
-                    dataPacket->setVia(LoRaPacketsToForward.front().getSource());
-                    dataPacket->setDestination(LoRaPacketsToForward.front().getDestination());
-                    dataPacket->setTtl(LoRaPacketsToForward.front().getTtl());
-                    dataPacket->getOptions().setAppACKReq(LoRaPacketsToForward.front().getOptions().getAppACKReq());
-                    dataPacket->setByteLength(LoRaPacketsToForward.front().getByteLength());
-                    dataPacket->setDepartureTime(LoRaPacketsToForward.front().getDepartureTime());
-
-                    // Erase the first packet in the forwarding buffer
-                    LoRaPacketsToForward.erase(LoRaPacketsToForward.begin());
-
-                    // Redundantly check that the packet has not been forwarded in the mean time, which should never occur
-                    if (!isPacketForwarded(dataPacket)) {
-                        bubble("Forwarding packet!");
-                        forwardedPackets++;
-                        forwardedDataPackets++;
-                        transmit = true;
-
-                        // Keep a copy of the forwarded packet to avoid sending it again if received later on
-                        LoRaPacketsForwarded.push_back(*dataPacket);
-                        if (LoRaPacketsForwarded.size() > forwardedPacketVectorSize){
-                            LoRaPacketsForwarded.erase(LoRaPacketsForwarded.begin());
-                        }
-                        break;
+        if (!routing->isForwarding()) {
+            // This should never happen
+            bubble("Forwarding disabled!");
+        }
+        else {
+            while (LoRaPacketsToForward.size() > 0) {
+                addName = "FWD-";
+                fullName += addName;
+                fullName += std::to_string(routingMetric);
+                addName = "-";
+                fullName += addName;
+                dataPacket->setName(fullName.c_str());
+
+                // Get the data from the first packet in the forwarding buffer to send it
+                dataPacket->setMsgType(LoRaPacketsToForward.front().msgType);
+                dataPacket->setDataInt(LoRaPacketsToForward.front().dataInt);
+                dataPacket->setSource(LoRaPacketsToForward.front().source);
+                dataPacket->setVia(LoRaPacketsToForward.front().source);
+                dataPacket->setDestination(LoRaPacketsToForward.front().destination);
+                dataPacket->setTtl(LoRaPacketsToForward.front().ttl);
+                dataPacket->getOptions().setAppACKReq(LoRaPacketsToForward.front().appACKReq);
+                dataPacket->setByteLength(LoRaPacketsToForward.front().byteLength);
+                dataPacket->setDepartureTime(LoRaPacketsToForward.front().departureTime);
+
+                // Erase the first packet in the forwarding buffer
+                packetsToForwardKeys.erase(getPacketKey(LoRaPacketsToForward.front()));
+                LoRaPacketsToForward.pop_front();
+
+                // Redundantly check that the packet has not been forwarded in the mean time, which should never occur
+                if (!isPacketForwarded(dataPacket)) {
+                    bubble("Forwarding packet!");
+                    forwardedPackets++;
+                    forwardedDataPackets++;
+                    transmit = true;
+
+                    // Keep the key of the forwarded packet to avoid sending it again if received later on
+                    LoRaPacketsForwarded.push_back(getPacketKey(dataPacket));
+                    packetsForwardedKeys.insert(LoRaPacketsForwarded.back());
+                    if (LoRaPacketsForwarded.size() > forwardedPacketVectorSize){
+                        packetsForwardedKeys.erase(LoRaPacketsForwarded.front());
+                        LoRaPacketsForwarded.pop_front();
                     }
+                    break;
                 }
-                break;
+            }
         }
     }
 
@@ -1341,52 +1233,43 @@ simtime_t LoRaNodeApp::sendDataPacket() {
 
         sanitizeRoutingTable();
 
-        int routeIndex = getBestRouteIndexTo(dataPacket->getDestination());
-
-        switch (routingMetric) {
-            case FLOODING_BROADCAST_SINGLE_SF:
-                dataPacket->setVia(BROADCAST_ADDRESS);
-
-            case SMART_BROADCAST_SINGLE_SF:
-            case HOP_COUNT_SINGLE_SF:
-            case RSSI_SUM_SINGLE_SF:
-            case RSSI_PROD_SINGLE_SF:
-            case ETX_SINGLE_SF:
-                if ( routeIndex >= 0 )
-                    dataPacket->setVia(singleMetricRoutingTable[routeIndex].via);
-                else {
-                    dataPacket->setVia(BROADCAST_ADDRESS);
-                    if (localData)
-                        broadcastDataPackets++;
-                    else
-                        broadcastForwardedPackets++;
-                }
-                break;
-            case TIME_ON_AIR_RMP1_CAD_MULTI_SF:
-                // Randomly pick a higher SF than needed for this route
-                if ( routeIndex >= 0 )
-                    cInfo->setLoRaSF(pickCADSF(dualMetricRoutingTable[routeIndex].sf));
+        singleMetricRoute *singleMetricBestRoute = nullptr;
+        dualMetricRoute *dualMetricBestRoute = nullptr;
+        if (singleMetricRoutesCount > 0)
+            singleMetricBestRoute = getBestSingleMetricRouteTo(dataPacket->getDestination());
+        else if (dualMetricRoutesCount > 0)
+            dualMetricBestRoute = getBestDualMetricRouteTo(dataPacket->getDestination());
+
+        if (dualMetricRouting != nullptr) {
+            // Randomly pick a higher SF than needed for this route
+            if (dualMetricRouting->picksRandomSF()) {
+                if ( dualMetricBestRoute != nullptr )
+                    cInfo->setLoRaSF(pickCADSF(dualMetricBestRoute->sf));
                 else
                     cInfo->setLoRaSF(pickCADSF(minLoRaSF));
-                // do not break;
-            case TIME_ON_AIR_NEWEST_CAD_MULTI_SF:
-            case TIME_ON_AIR_RANDOM_CAD_MULTI_SF:
-            case TIME_ON_AIR_HC_CAD_MULTI_SF:
-            case TIME_ON_AIR_ETX_CAD_MULTI_SF:
-            case TIME_ON_AIR_FQUEUE_CAD_MULTI_SF:
-            default:
-                if ( routeIndex >= 0 ) {
-                    dataPacket->setVia(dualMetricRoutingTable[routeIndex].via);
-                    cInfo->setLoRaSF(dualMetricRoutingTable[routeIndex].sf);
-                }
-                else {
-                    dataPacket->setVia(BROADCAST_ADDRESS);
-                    if (localData)
-                        broadcastDataPackets++;
-                    else
-                        broadcastForwardedPackets++;
-                }
-                break;
+            }
+            if ( dualMetricBestRoute != nullptr ) {
+                dataPacket->setVia(dualMetricBestRoute->via);
+                cInfo->setLoRaSF(dualMetricBestRoute->sf);
+            }
+            else {
+                dataPacket->setVia(BROADCAST_ADDRESS);
+                if (localData)
+                    broadcastDataPackets++;
+                else
+                    broadcastForwardedPackets++;
+            }
+        }
+        else {
+            if ( singleMetricBestRoute != nullptr )
+                dataPacket->setVia(singleMetricBestRoute->via);
+            else {
+                dataPacket->setVia(BROADCAST_ADDRESS);
+                if (localData)
+                    broadcastDataPackets++;
+                else
+                    broadcastForwardedPackets++;
+            }
         }
 
         dataPacket->setControlInfo(cInfo);
@@ -1412,7 +1295,7 @@ simtime_t LoRaNodeApp::sendDataPacket() {
     }
 
     // Generate more packets if needed
-    if (sendPacketsContinuously && LoRaPacketsToSend.size() == 0) {
+    if (sendPacketsContinuously && !dataPacketGenerator.hasNext()) {
         generateDataPackets();
     }
 
@@ -1438,30 +1321,20 @@ simtime_t LoRaNodeApp::sendRoutingPacket() {
     sanitizeRoutingTable();
 
     std::vector<LoRaRoute> theseLoRaRoutes;
-    int singleMetricRoutesCount = end(singleMetricRoutingTable) - begin(singleMetricRoutingTable);
-    int dualMetricRoutesCount = end(dualMetricRoutingTable) - begin(dualMetricRoutingTable);
-
-    switch (routingMetric) {
-
-        case NO_FORWARDING:
-            break;
 
-        case FLOODING_BROADCAST_SINGLE_SF:
-        case SMART_BROADCAST_SINGLE_SF:
-            break;
+    // Single-SF metrics
+    if (singleMetricRouting != nullptr) {
 
-        // Single-SF metrics
-        case HOP_COUNT_SINGLE_SF:
-        case RSSI_SUM_SINGLE_SF:
-        case RSSI_PROD_SINGLE_SF:
-        case ETX_SINGLE_SF:
-
-            transmit = true;
+        transmit = true;
 
+        if (incrementalRoutingPackets) {
+            addIncrementalRoutesToRoutingPacket(routingPacket);
+        }
+        else {
             // Count the number of best routes
             for (int i=0; i<numberOfNodes; i++) {
                 if (i != nodeId) {
-                    if (getBestRouteIndexTo(i) >= 0) {
+                    if (hasRouteTo(i)) {
                         numberOfRoutes++;
                     }
                 }
@@ -1473,63 +1346,58 @@ simtime_t LoRaNodeApp::sendRoutingPacket() {
             // Add the best route to each node to the routing packet
             for (int i=0; i<numberOfNodes; i++) {
                 if (i != nodeId) {
-                    if (getBestRouteIndexTo(i) >= 0) {
+                    const singleMetricRoute *bestRoute = getBestSingleMetricRouteTo(i);
+                    if (bestRoute != nullptr) {
 
                         LoRaRoute thisLoRaRoute;
-                        thisLoRaRoute.setId(singleMetricRoutingTable[getBestRouteIndexTo(i)].id);
-                        thisLoRaRoute.setPriMetric(singleMetricRoutingTable[getBestRouteIndexTo(i)].metric);
+                        thisLoRaRoute.setId(bestRoute->id);
+                        thisLoRaRoute.setPriMetric(bestRoute->metric);
                         routingPacket->setRoutingTable(numberOfRoutes-1, thisLoRaRoute);
                         numberOfRoutes--;
                     }
                 }
             }
+        }
+    }
 
-            break;
-
-        // Multi-SF metrics
-        case TIME_ON_AIR_NEWEST_CAD_MULTI_SF:
-        case TIME_ON_AIR_RANDOM_CAD_MULTI_SF:
-        case TIME_ON_AIR_HC_CAD_MULTI_SF:
-        case TIME_ON_AIR_ETX_CAD_MULTI_SF:
-        case TIME_ON_AIR_FQUEUE_CAD_MULTI_SF:
-        case TIME_ON_AIR_RMP1_CAD_MULTI_SF:
-            transmit = true;
+    // Multi-SF metrics
+    else if (dualMetricRouting != nullptr) {
+        transmit = true;
 
-            // Count the number of best routes
-            for (int i=0; i<numberOfNodes; i++) {
-                if (i != nodeId) {
-                    if (getBestRouteIndexTo(i) >= 0) {
-                        numberOfRoutes++;
-                    }
+        // Count the number of best routes
+        for (int i=0; i<numberOfNodes; i++) {
+            if (i != nodeId) {
+                if (hasRouteTo(i)) {
+                    numberOfRoutes++;
                 }
             }
+        }
 
-            // Save the number of routes to the packet
-            routingPacket->setRoutingTableArraySize(numberOfRoutes);
+        // Save the number of routes to the packet
+        routingPacket->setRoutingTableArraySize(numberOfRoutes);
 
-            std::vector<LoRaRoute> allLoRaRoutes;
+        std::vector<LoRaRoute> allLoRaRoutes;
 
-            //routingPacket->setRoutingTableArraySize(dualMetricRoutesCount);
+        //routingPacket->setRoutingTableArraySize(dualMetricRoutesCount);
 
-            // Add the best route to each node to the routing packet
-            for (int i=0; i<numberOfNodes; i++) {
-                if (i != nodeId) {
-                    if (getBestRouteIndexTo(i) >= 0 ){
-                        LoRaRoute thisLoRaRoute;
-                        thisLoRaRoute.setId(dualMetricRoutingTable[getBestRouteIndexTo(i)].id); //i.e., "i"
-                        thisLoRaRoute.setPriMetric(dualMetricRoutingTable[getBestRouteIndexTo(i)].priMetric);
-                        thisLoRaRoute.setSecMetric(dualMetricRoutingTable[getBestRouteIndexTo(i)].secMetric);
-                        routingPacket->setRoutingTable(numberOfRoutes-1, thisLoRaRoute);
-                        numberOfRoutes--;
-                    }
+        // Add the best route to each node to the routing packet
+        for (int i=0; i<numberOfNodes; i++) {
+            if (i != nodeId) {
+                const dualMetricRoute *bestRoute = getBestDualMetricRouteTo(i);
+                if (bestRoute != nullptr) {
+                    LoRaRoute thisLoRaRoute;
+                    thisLoRaRoute.setId(bestRoute->id); //i.e., "i"
+                    thisLoRaRoute.setPriMetric(bestRoute->priMetric);
+                    thisLoRaRoute.setSecMetric(bestRoute->secMetric);
+                    routingPacket->setRoutingTable(numberOfRoutes-1, thisLoRaRoute);
+                    numberOfRoutes--;
                 }
             }
+        }
 
-           // Decide on what SF to transmit and the packet is done
-           loRaSF = pickCADSF(minLoRaSF);
-           cInfo->setLoRaSF(loRaSF);
-
-           break;
+        // Decide on what SF to transmit and the packet is done
+        loRaSF = pickCADSF(minLoRaSF);
+        cInfo->setLoRaSF(loRaSF);
     }
 
 
@@ -1547,7 +1415,13 @@ simtime_t LoRaNodeApp::sendRoutingPacket() {
         routingPacket->setVia(nodeId);
         routingPacket->setDestination(BROADCAST_ADDRESS);
         routingPacket->getOptions().setAppACKReq(false);
-        routingPacket->setByteLength(routingPacketMaxSize);
+        if (incrementalRoutingPackets) {
+            routingPacket->setByteLength(std::min(routingPacketMaxSize,
+                    routingPacketHeaderSize + routingPacketRouteSize * (int)routingPacket->getRoutingTableArraySize()));
+        }
+        else {
+            routingPacket->setByteLength(routingPacketMaxSize);
+        }
         routingPacket->setDepartureTime(simTime());
 
         txSfVector.record(loRaSF);
@@ -1568,62 +1442,84 @@ simtime_t LoRaNodeApp::sendRoutingPacket() {
     return txDuration;
 }
 
-void LoRaNodeApp::generateDataPackets() {
-
-    if (!onlyNode0SendsPackets || nodeId == 0) {
-        std::vector<int> destinations = { };
+void LoRaNodeApp::addIncrementalRoutesToRoutingPacket(LoRaAppPacket *routingPacket) {
 
-        if (numberOfDestinationsPerNode == 0 )
-            numberOfDestinationsPerNode = numberOfNodes-1;
+    bool fullRoutingTable = (routingPacketsSinceFullRefresh == 0);
+    routingPacketsSinceFullRefresh = (routingPacketsSinceFullRefresh + 1) % fullRoutingPacketInterval;
 
-        while (destinations.size() < numberOfDestinationsPerNode
-                && numberOfNodes - 1 - destinations.size() > 0) {
+    std::vector<LoRaRoute> theseLoRaRoutes;
 
-            int destination = intuniform(0, numberOfNodes - 1);
+    // Same route order as in full routing packets
+    for (int i=numberOfNodes-1; i>=0; i--) {
+        if (i != nodeId) {
+            const singleMetricRoute *bestRoute = getBestSingleMetricRouteTo(i);
+            auto advertisedRoute = advertisedRoutes.find(i);
 
-            if (destination != nodeId) {
-                bool newDestination = true;
+            if (bestRoute != nullptr) {
+                LoRaRoute thisLoRaRoute;
+                thisLoRaRoute.setId(bestRoute->id);
+                thisLoRaRoute.setPriMetric(bestRoute->metric);
 
-                for (int i = 0; i < destinations.size(); i++) {
-                    if (destination == destinations[i]) {
-                        newDestination = false;
-                        break;
-                    }
+                if (fullRoutingTable || advertisedRoute == advertisedRoutes.end() ||
+                        advertisedRoute->second.getPriMetric() != thisLoRaRoute.getPriMetric()) {
+                    theseLoRaRoutes.push_back(thisLoRaRoute);
                 }
-
-                if (newDestination) {
-                    destinations.push_back(destination);
+                advertisedRoutes[i] = thisLoRaRoute;
+            }
+            // A full routing table implicitly withdraws the routes it lacks
+            else if (advertisedRoute != advertisedRoutes.end()) {
+                if (!fullRoutingTable) {
+                    LoRaRoute withdrawnLoRaRoute;
+                    withdrawnLoRaRoute.setId(i);
+                    withdrawnLoRaRoute.setPriMetric(WITHDRAWN_ROUTE_METRIC);
+                    theseLoRaRoutes.push_back(withdrawnLoRaRoute);
                 }
+                advertisedRoutes.erase(advertisedRoute);
             }
         }
+    }
 
-        for (int k = 0; k < numberOfPacketsPerDestination; k++) {
-            for (int j = 0; j < destinations.size(); j++) {
-                LoRaAppPacket *dataPacket = new LoRaAppPacket("DataPacket");
-
-                dataPacket->setMsgType(DATA);
-                dataPacket->setDataInt(currDataInt+k);
-                dataPacket->setSource(nodeId);
-                dataPacket->setVia(nodeId);
-                dataPacket->setDestination(destinations[j]);
-                dataPacket->getOptions().setAppACKReq(requestACKfromApp);
-                dataPacket->setByteLength(dataPacketSize);
-                dataPacket->setDepartureTime(simTime());
-
-                switch (routingMetric) {
-    //            case 0:
-    //                dataPacket->setTtl(1);
-    //                break;
-                default:
-                    dataPacket->setTtl(packetTTL);
-                    break;
-                }
+    routingPacket->setFullRoutingTable(fullRoutingTable);
+    routingPacket->setRoutingTableArraySize(theseLoRaRoutes.size());
+    for (unsigned int j=0; j<theseLoRaRoutes.size(); j++) {
+        routingPacket->setRoutingTable(j, theseLoRaRoutes[j]);
+    }
+}
 
-                LoRaPacketsToSend.push_back(*dataPacket);
-                delete dataPacket;
-            }
-            currDataInt++;
-        }
+void LoRaNodeApp::updateRoutingNeighbour(const LoRaAppPacket *packet) {
+    routingNeighbour& neighbour = routingNeighbours[packet->getSource()];
+    int sequence = packet->getDataInt();
+
+    if (packet->getFullRoutingTable()) {
+        neighbour.synchronized = true;
+        neighbour.fullSequence = sequence;
+    }
+    else if (neighbour.synchronized && sequence != neighbour.lastSequence + 1) {
+        // Some changes may have been missed: wait for the next full routing table
+        neighbour.synchronized = false;
+        routingPacketSequenceGaps++;
+    }
+    neighbour.lastSequence = sequence;
+    neighbour.valid = simTime() + routeTimeout;
+}
+
+bool LoRaNodeApp::isRouteKeptAliveByNeighbour(const singleMetricRoute& route) {
+    if (!incrementalRoutingPackets)
+        return false;
+
+    // A route last carried before the neighbour's latest full routing table
+    // was left out of it, i.e. withdrawn
+    auto neighbour = routingNeighbours.find(route.via);
+    return neighbour != routingNeighbours.end() && neighbour->second.synchronized
+            && route.advertisedSequence >= neighbour->second.fullSequence
+            && !(neighbour->second.valid < simTime());
+}
+
+void LoRaNodeApp::generateDataPackets() {
+
+    if (!onlyNode0SendsPackets || nodeId == 0) {
+        dataPacketGenerator.startRound(currDataInt);
+        currDataInt += numberOfPacketsPerDestination;
     }
 }
 
@@ -1647,41 +1543,126 @@ bool LoRaNodeApp::isNeighbour(int neighbourId) {
 }
 
 bool LoRaNodeApp::isRouteInSingleMetricRoutingTable(int id, int via) {
-    if (getRouteIndexInSingleMetricRoutingTable(id, via) >= 0) {
-        return true;
-    }
-    return false;
+    return getRouteInSingleMetricRoutingTable(id, via) != nullptr;
 }
 
-int LoRaNodeApp::getRouteIndexInSingleMetricRoutingTable(int id, int via) {
-    int singleMetricRoutesCount = end(singleMetricRoutingTable) - begin(singleMetricRoutingTable);
+LoRaNodeApp::singleMetricRoute *LoRaNodeApp::getRouteInSingleMetricRoutingTable(int id, int via) {
+    auto bucket = singleMetricRoutingTable.find(id);
 
-    for (int i = 0; i < singleMetricRoutesCount; i++) {
-        if (singleMetricRoutingTable[i].id == id && singleMetricRoutingTable[i].via == via) {
-            return i;
+    if (bucket != singleMetricRoutingTable.end()) {
+        for (auto& route : bucket->second.routes) {
+            if (route.via == via) {
+                return &route;
+            }
         }
     }
 
-    return -1;
+    return nullptr;
 }
 
 bool LoRaNodeApp::isRouteInDualMetricRoutingTable(int id, int via, int sf) {
-    if (getRouteIndexInDualMetricRoutingTable(id, via, sf) >= 0) {
-        return true;
+    return getRouteInDualMetricRoutingTable(id, via, sf) != nullptr;
+}
+
+LoRaNodeApp::dualMetricRoute *LoRaNodeApp::getRouteInDualMetricRoutingTable(int id, int via, int sf) {
+    auto bucket = dualMetricRoutingTable.find(id);
+
+    if (bucket != dualMetricRoutingTable.end()) {
+        for (auto& route : bucket->second.routes) {
+            if (route.via == via && route.sf == sf) {
+                return &route;
+            }
+        }
     }
-    return false;
+
+    return nullptr;
+}
+
+void LoRaNodeApp::addRouteToSingleMetricRoutingTable(const singleMetricRoute& route) {
+    singleMetricRouteBucket& bucket = singleMetricRoutingTable[route.id];
+    bucket.routes.push_back(route);
+    bucket.bestRoute = -1;
+    singleMetricRoutesCount++;
+    scheduleRouteExpiry(route.id, route.via, -1, route.valid);
+}
+
+void LoRaNodeApp::addRouteToDualMetricRoutingTable(const dualMetricRoute& route) {
+    dualMetricRouteBucket& bucket = dualMetricRoutingTable[route.id];
+    bucket.routes.push_back(route);
+    bucket.bestRoute = -1;
+    dualMetricRoutesCount++;
+    scheduleRouteExpiry(route.id, route.via, route.sf, route.valid);
+}
+
+void LoRaNodeApp::removeRouteFromSingleMetricRoutingTable(int id, int via) {
+    auto bucket = singleMetricRoutingTable.find(id);
+    if (bucket == singleMetricRoutingTable.end())
+        return;
+    std::vector<singleMetricRoute>& routes = bucket->second.routes;
+    for (auto route = routes.begin(); route != routes.end(); route++) {
+        if (route->via == via) {
+            routes.erase(route);
+            bucket->second.bestRoute = -1;
+            singleMetricRoutesCount--;
+            deletedRoutes++;
+            break;
+        }
+    }
+    if (routes.empty())
+        singleMetricRoutingTable.erase(bucket);
+}
+
+LoRaNodeApp::etxWindow& LoRaNodeApp::getETXWindow(int neighbour, int sf) {
+    return etxWindows[(neighbour << 4) | sf];
+}
+
+void LoRaNodeApp::routeUpdated(const singleMetricRoute& route) {
+    singleMetricRoutingTable[route.id].bestRoute = -1;
+    scheduleRouteExpiry(route.id, route.via, -1, route.valid);
 }
 
-int LoRaNodeApp::getRouteIndexInDualMetricRoutingTable(int id, int via, int sf) {
-    int dualMetricRoutesCount = end(dualMetricRoutingTable) - begin(dualMetricRoutingTable);
+void LoRaNodeApp::routeUpdated(const dualMetricRoute& route) {
+    dualMetricRoutingTable[route.id].bestRoute = -1;
+    scheduleRouteExpiry(route.id, route.via, route.sf, route.valid);
+}
 
-    for (int i = 0; i < dualMetricRoutesCount; i++) {
-        if (dualMetricRoutingTable[i].id == id && dualMetricRoutingTable[i].via == via && dualMetricRoutingTable[i].sf == sf) {
-            return i;
+void LoRaNodeApp::scheduleRouteExpiry(int id, int via, int sf, simtime_t valid) {
+    routeExpiry expiry;
+    expiry.valid = valid;
+    expiry.id = id;
+    expiry.via = via;
+    expiry.sf = sf;
+    routeExpiries.push(expiry);
+
+    // Refreshed routes leave their previous expiry behind; drop these stale
+    // entries once they outnumber the live routes
+    if (routeExpiries.size() > 2 * (size_t)(singleMetricRoutesCount + dualMetricRoutesCount) + 64) {
+        std::vector<routeExpiry> liveExpiries;
+        for (auto& bucket : singleMetricRoutingTable) {
+            for (auto& route : bucket.second.routes) {
+                routeExpiry liveExpiry = { route.valid, route.id, route.via, -1 };
+                liveExpiries.push_back(liveExpiry);
+            }
+        }
+        for (auto& bucket : dualMetricRoutingTable) {
+            for (auto& route : bucket.second.routes) {
+                routeExpiry liveExpiry = { route.valid, route.id, route.via, route.sf };
+                liveExpiries.push_back(liveExpiry);
+            }
         }
+        routeExpiries = std::priority_queue<routeExpiry, std::vector<routeExpiry>, std::greater<routeExpiry>>(std::greater<routeExpiry>(), std::move(liveExpiries));
     }
+}
 
-    return -1;
+bool LoRaNodeApp::hasRouteTo(int destination) {
+    // Empty buckets are removed from the tables, so any bucket holds at least one route
+    if (singleMetricRoutesCount > 0) {
+        return singleMetricRoutingTable.find(destination) != singleMetricRoutingTable.end();
+    }
+    else if (dualMetricRoutesCount > 0) {
+        return dualMetricRoutingTable.find(destination) != dualMetricRoutingTable.end();
+    }
+    return false;
 }
 
 
@@ -1708,49 +1689,43 @@ bool LoRaNodeApp::isACKed(int nodeId) {
 bool LoRaNodeApp::isPacketForwarded(cMessage *msg) {
     LoRaAppPacket *packet = check_and_cast<LoRaAppPacket *>(msg);
 
-    for (std::vector<LoRaAppPacket>::iterator lbptr =
-            LoRaPacketsForwarded.begin(); lbptr < LoRaPacketsForwarded.end();
-            lbptr++) {
-        if (packet->getMsgType() == lbptr->getMsgType()
-                && packet->getDataInt() == lbptr->getDataInt()
-                && packet->getSource() == lbptr->getSource()
-                && packet->getDestination() == lbptr->getDestination()) {
-            return true;
-        }
-    }
-    return false;
+    return packetsForwardedKeys.find(getPacketKey(packet)) != packetsForwardedKeys.end();
 }
 
 bool LoRaNodeApp::isPacketToBeForwarded(cMessage *msg) {
     LoRaAppPacket *packet = check_and_cast<LoRaAppPacket *>(msg);
 
-    for (std::vector<LoRaAppPacket>::iterator lbptr =
-            LoRaPacketsToForward.begin(); lbptr < LoRaPacketsToForward.end();
-            lbptr++) {
-        if (packet->getMsgType() == lbptr->getMsgType()
-                && packet->getDataInt() == lbptr->getDataInt()
-                && packet->getSource() == lbptr->getSource()
-                && packet->getDestination() == lbptr->getDestination()) {
-            return true;
-        }
-    }
-    return false;
+    return packetsToForwardKeys.find(getPacketKey(packet)) != packetsToForwardKeys.end();
 }
 
 bool LoRaNodeApp::isDataPacketForMeUnique(cMessage *msg) {
     LoRaAppPacket *packet = check_and_cast<LoRaAppPacket *>(msg);
 
-    for (std::vector<LoRaAppPacket>::iterator lbptr =
-            DataPacketsForMe.begin(); lbptr < DataPacketsForMe.end();
-            lbptr++) {
-        if (packet->getMsgType() == lbptr->getMsgType()
-                && packet->getDataInt() == lbptr->getDataInt()
-                && packet->getSource() == lbptr->getSource()
-                && packet->getDestination() == lbptr->getDestination()) {
-            return false;
-        }
-    }
-    return true;
+    return dataPacketsForMeKeys.find(getPacketKey(packet)) == dataPacketsForMeKeys.end();
+}
+
+uint64_t LoRaNodeApp::getPacketKey(int msgType, int source, int destination, int dataInt) const {
+    // A packet is identified by its type, source, destination and dataInt, packed
+    // as msgType (4 bits) | source (14 bits) | destination (14 bits) | dataInt (32 bits)
+    const int nodeMask = (1 << 14) - 1;
+    int packedDestination = destination == BROADCAST_ADDRESS ? nodeMask : destination;
+
+    if (msgType < 0 || msgType > 15
+            || source < 0 || source >= nodeMask
+            || packedDestination < 0 || packedDestination > nodeMask)
+        throw cRuntimeError("Packet identity out of range: msgType %d, source %d, destination %d",
+                msgType, source, destination);
+
+    return ((uint64_t)msgType << 60) | ((uint64_t)source << 46)
+            | ((uint64_t)packedDestination << 32) | (uint32_t)dataInt;
+}
+
+uint64_t LoRaNodeApp::getPacketKey(const LoRaAppPacket *packet) const {
+    return getPacketKey(packet->getMsgType(), packet->getSource(), packet->getDestination(), packet->getDataInt());
+}
+
+uint64_t LoRaNodeApp::getPacketKey(const LoRaAppPacketEntry& entry) const {
+    return getPacketKey(entry.msgType, entry.source, entry.destination, entry.dataInt);
 }
 
 int LoRaNodeApp::pickCADSF(int lowestSF) {
@@ -1763,190 +1738,106 @@ int LoRaNodeApp::pickCADSF(int lowestSF) {
     } while (true);
 }
 
-int LoRaNodeApp::getBestRouteIndexTo(int destination) {
-    if (singleMetricRoutingTable.size() > 0) {
-
-        int singleMetricRoutesCount = end(singleMetricRoutingTable) - begin(singleMetricRoutingTable);
-
-        std::vector<singleMetricRoute> availableRoutes;
-
-        for (int i = 0; i < singleMetricRoutesCount; i++) {
-            if (singleMetricRoutingTable[i].id == destination) {
-                availableRoutes.push_back(singleMetricRoutingTable[i]);
-
-            }
-        }
-
-        if (availableRoutes.size() > 0) {
-            int bestRoute = 0;
-            int bestMetric = availableRoutes[0].metric;
-
-            int availableRoutesCount = end(availableRoutes) - begin(availableRoutes);
-            for (int j = 0; j < availableRoutesCount; j++) {
-                if (availableRoutes[j].metric < bestMetric) {
-                    bestMetric = availableRoutes[j].metric;
-                }
-            }
-
-            simtime_t lastMetric = 0;
-
-            for (int k = 0; k < availableRoutesCount; k++) {
-                if (availableRoutes[k].metric == bestMetric) {
-                    if (availableRoutes[k].valid >= lastMetric) {
-                        bestRoute = k;
-                        lastMetric = availableRoutes[k].valid;
-                    }
-                }
-            }
-            return getRouteIndexInSingleMetricRoutingTable(availableRoutes[bestRoute].id, availableRoutes[bestRoute].via);
-        }
-    } // End single-SF metrics
-
-    else if (dualMetricRoutingTable.size() > 0) {
-        int dualMetricRoutesCount = dualMetricRoutingTable.size();
+LoRaNodeApp::singleMetricRoute *LoRaNodeApp::getBestSingleMetricRouteTo(int destination) {
+    auto it = singleMetricRoutingTable.find(destination);
 
-        std::vector<dualMetricRoute> availableRoutes;
-        std::vector<dualMetricRoute> tieRoutes;
+    if (it == singleMetricRoutingTable.end()) {
+        return nullptr;
+    }
 
-        for (int i = 0; i < dualMetricRoutesCount; i++) {
-            if (dualMetricRoutingTable[i].id == destination) {
-                availableRoutes.push_back(dualMetricRoutingTable[i]);
-            }
-        }
+    singleMetricRouteBucket& bucket = it->second;
+    if (bucket.bestRoute < 0) {
+        bucket.bestRoute = singleMetricRouting->selectBestRoute(bucket.routes);
+    }
+    return &bucket.routes[bucket.bestRoute];
+}
 
-        if (availableRoutes.size() > 0) {
-            int bestRoute = 0;
-
-            int availableRoutesCount = end(availableRoutes) - begin(availableRoutes);
-            int tieRoutesCount = 0;
-            int j;
-
-            switch (routingMetric) {
-                case TIME_ON_AIR_NEWEST_CAD_MULTI_SF:
-                    // Find best priMetric with longest validity, no ties expected
-                    for (j = 0; j < availableRoutesCount; j++) {
-                        if ( availableRoutes[j].priMetric < availableRoutes[bestRoute].priMetric ||
-                                ( availableRoutes[j].priMetric == availableRoutes[bestRoute].priMetric &&
-                                        availableRoutes[j].valid > availableRoutes[bestRoute].valid) ) {
-                            bestRoute = j;
-                        }
-                    }
-                    break;
-                case TIME_ON_AIR_RANDOM_CAD_MULTI_SF:
-                    // Find best routes by priMetric, choose randomly from ties.
-                    // Find best priMetric value
-                    for (j = 0; j < availableRoutesCount; j++) {
-                        if (availableRoutes[j].priMetric < availableRoutes[bestRoute].priMetric) {
-                            bestRoute = j;
-                        }
-                    }
-                    // Find ties
-                    for (j = 0; j < availableRoutesCount; j++) {
-                        if (availableRoutes[j].priMetric == availableRoutes[bestRoute].priMetric) {
-                            tieRoutes.push_back(availableRoutes[j]);
-                        }
-                    }
-                    // Count ties
-                    tieRoutesCount = end(tieRoutes) - begin(tieRoutes);
-                    // Return a random route among the ties
-                    if (tieRoutesCount > 0) {
-                        int bestTieRoute = intuniform(0, tieRoutesCount-1);
-                        return getRouteIndexInDualMetricRoutingTable(tieRoutes[bestTieRoute].id, tieRoutes[bestTieRoute].via, tieRoutes[bestTieRoute].sf);
-                    }
-                    break;
-                case TIME_ON_AIR_HC_CAD_MULTI_SF:
-                case TIME_ON_AIR_ETX_CAD_MULTI_SF:
-                case TIME_ON_AIR_FQUEUE_CAD_MULTI_SF:
-                case TIME_ON_AIR_RMP1_CAD_MULTI_SF:
-                default:
-                    for (j = 0; j < availableRoutesCount; j++) {
-                        if (availableRoutes[j].priMetric < availableRoutes[bestRoute].priMetric ||
-                                ( availableRoutes[j].priMetric == availableRoutes[bestRoute].priMetric &&
-                                        availableRoutes[j].secMetric < availableRoutes[bestRoute].secMetric) ||
-                                        ( availableRoutes[j].priMetric == availableRoutes[bestRoute].priMetric &&
-                                                availableRoutes[j].secMetric == availableRoutes[bestRoute].secMetric &&
-                                                availableRoutes[j].valid > availableRoutes[bestRoute].valid)) {
-                            bestRoute = j;
-                        }
-                    }
-                    break;
-            }
+LoRaNodeApp::dualMetricRoute *LoRaNodeApp::getBestDualMetricRouteTo(int destination) {
+    auto it = dualMetricRoutingTable.find(destination);
 
-            return getRouteIndexInDualMetricRoutingTable(availableRoutes[bestRoute].id, availableRoutes[bestRoute].via, availableRoutes[bestRoute].sf);
-        }
-    } // End mulit-SF metrics
+    if (it == dualMetricRoutingTable.end()) {
+        return nullptr;
+    }
 
-    // If no route found, or no routes at all
-    return -1;
+    dualMetricRouteBucket& bucket = it->second;
+    // Ties may be broken randomly on every lookup, so the result can't always be cached
+    if (!dualMetricRouting->isBestRouteCacheable()) {
+        return &bucket.routes[dualMetricRouting->selectBestRoute(bucket.routes, getRNG(0))];
+    }
+    if (bucket.bestRoute < 0) {
+        bucket.bestRoute = dualMetricRouting->selectBestRoute(bucket.routes, getRNG(0));
+    }
+    return &bucket.routes[bucket.bestRoute];
 }
 
 void LoRaNodeApp::sanitizeRoutingTable() {
-    bool routeDeleted = false;
-
-    if (singleMetricRoutingTable.size() > 0) {
-
-        do {
-            routeDeleted = false;
-
-            for (std::vector<singleMetricRoute>::iterator smr =
-                    singleMetricRoutingTable.begin(); smr < singleMetricRoutingTable.end();
-                    smr++) {
-                if (smr->valid < simTime()) {
-                    singleMetricRoutingTable.erase(smr);
-                    routeDeleted = true;
-                    deletedRoutes++;
+    // Only routes whose expiry time has passed are visited. An entry is stale,
+    // and simply dropped, when its route has been refreshed or removed since.
+    while (!routeExpiries.empty() && routeExpiries.top().valid < simTime()) {
+        routeExpiry expiry = routeExpiries.top();
+        routeExpiries.pop();
+
+        if (expiry.sf < 0) {
+            auto bucket = singleMetricRoutingTable.find(expiry.id);
+            if (bucket == singleMetricRoutingTable.end())
+                continue;
+            std::vector<singleMetricRoute>& routes = bucket->second.routes;
+            for (auto route = routes.begin(); route != routes.end(); route++) {
+                if (route->via == expiry.via && route->valid == expiry.valid) {
+                    if (isRouteKeptAliveByNeighbour(*route)) {
+                        route->valid = routingNeighbours[route->via].valid;
+                        routeUpdated(*route);
+                    }
+                    else {
+                        routes.erase(route);
+                        bucket->second.bestRoute = -1;
+                        singleMetricRoutesCount--;
+                        deletedRoutes++;
+                    }
                     break;
                 }
             }
-        } while (routeDeleted);
-    }
-    else if (dualMetricRoutingTable.size() > 0) {
-
-        do {
-            routeDeleted = false;
-
-            for (std::vector<dualMetricRoute>::iterator dmr =
-                    dualMetricRoutingTable.begin(); dmr < dualMetricRoutingTable.end();
-                    dmr++) {
-                if (dmr->valid < simTime()) {
-                    dualMetricRoutingTable.erase(dmr);
-                    routeDeleted = true;
+            if (routes.empty())
+                singleMetricRoutingTable.erase(bucket);
+        }
+        else {
+            auto bucket = dualMetricRoutingTable.find(expiry.id);
+            if (bucket == dualMetricRoutingTable.end())
+                continue;
+            std::vector<dualMetricRoute>& routes = bucket->second.routes;
+            for (auto route = routes.begin(); route != routes.end(); route++) {
+                if (route->via == expiry.via && route->sf == expiry.sf && route->valid == expiry.valid) {
+                    routes.erase(route);
+                    bucket->second.bestRoute = -1;
+                    dualMetricRoutesCount--;
                     deletedRoutes++;
                     break;
                 }
             }
-        } while (routeDeleted);
+            if (routes.empty())
+                dualMetricRoutingTable.erase(bucket);
+        }
     }
 }
 
 int LoRaNodeApp::getSFTo(int destination) {
-    if (dualMetricRoutingTable.size() > 0) {
-        int dualMetricRoutesCount = end(dualMetricRoutingTable) - begin(dualMetricRoutingTable);
-
-        std::vector<dualMetricRoute> availableRoutes;
+    auto it = dualMetricRoutingTable.find(destination);
 
-        for (int i = 0; i < dualMetricRoutesCount; i++) {
-            if (dualMetricRoutingTable[i].id == destination) {
-                availableRoutes.push_back(dualMetricRoutingTable[i]);
-            }
-        }
-
-        dualMetricRoutesCount = end(dualMetricRoutingTable) - begin(dualMetricRoutingTable);
+    if (it != dualMetricRoutingTable.end()) {
+        const std::vector<dualMetricRoute>& availableRoutes = it->second.routes;
 
-        if (availableRoutes.size() > 0) {
-            int bestRoute = 0;
+        int bestRoute = 0;
 
-            int availableRoutesCount = end(availableRoutes) - begin(availableRoutes);
+        int availableRoutesCount = availableRoutes.size();
 
-            for (int j = 0; j < availableRoutesCount; j++) {
-                if (availableRoutes[j].sf < availableRoutes[bestRoute].sf) {
-                    bestRoute = j;
-                }
+        for (int j = 0; j < availableRoutesCount; j++) {
+            if (availableRoutes[j].sf < availableRoutes[bestRoute].sf) {
+                bestRoute = j;
             }
+        }
 
-            if ( availableRoutes[bestRoute].sf >= minLoRaSF && availableRoutes[bestRoute].sf <= maxLoRaSF) {
-                return availableRoutes[bestRoute].sf;
-            }
+        if ( availableRoutes[bestRoute].sf >= minLoRaSF && availableRoutes[bestRoute].sf <= maxLoRaSF) {
+            return availableRoutes[bestRoute].sf;
         }
     }
 
@@ -1961,18 +1852,9 @@ simtime_t LoRaNodeApp::calculateTransmissionDuration(cMessage *msg) {
     const LoRaAppPacket *frame = check_and_cast<const LoRaAppPacket *>(msg);
     const LoRaMacControlInfo *cInfo = check_and_cast<const LoRaMacControlInfo *>(frame->getControlInfo());
 
-    int nPreamble = 8;
-    simtime_t Tsym = (pow(2, cInfo->getLoRaSF()))/(cInfo->getLoRaBW().get()/1000);
-    simtime_t Tpreamble = (nPreamble + 4.25) * Tsym / 1000;
-
     int payloadBytes = frame->getByteLength()+8; //+8 bytes for headers
 
-    int payloadSymbNb = 8 + math::max(ceil((8*payloadBytes - 4*cInfo->getLoRaSF() + 28 + 16 - 20*0)/(4*(cInfo->getLoRaSF()-2*0)))*(cInfo->getLoRaCR() + 4), 0);
-
-    simtime_t Theader = 0.5 * (8+payloadSymbNb) * Tsym / 1000;
-    simtime_t Tpayload = 0.5 * (8+payloadSymbNb) * Tsym / 1000;
-
-    const simtime_t duration = Tpreamble + Theader + Tpayload;
+    const simtime_t duration = physicallayer::LoRaPhyTables::computeAirtime(cInfo->getLoRaSF(), cInfo->getLoRaBW(), cInfo->getLoRaCR(), payloadBytes).getDuration();
     return duration;
 }
 
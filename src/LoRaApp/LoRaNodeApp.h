@@ -18,6 +18,12 @@
 
 #include <omnetpp.h>
 #include <string>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "inet/common/lifecycle/ILifecycle.h"
 #include "inet/common/lifecycle/NodeStatus.h"
@@ -26,16 +32,37 @@
 #include "inet/common/FSMA.h"
 
 #include "LoRaAppPacket_m.h"
+#include "LoRaTerminationCoordinator.h"
+#include "LoRaDataPacketGenerator.h"
+#include "LoRaRoutingMetric.h"
 #include "LoRa/LoRaMacControlInfo_m.h"
 
 using namespace omnetpp;
 
 namespace inet {
 
+class LoRaMac;
+
+/**
+ * Descriptor of a data packet waiting in a node buffer. The LoRaAppPacket
+ * itself is only created when the packet is actually sent.
+ */
+struct LoRaAppPacketEntry
+{
+    int msgType;
+    int dataInt;
+    int source;
+    int destination;
+    int ttl;
+    int byteLength;
+    bool appACKReq;
+    simtime_t departureTime;
+};
+
 /**
  * TODO - Generated class
  */
-class INET_API LoRaNodeApp : public cSimpleModule, public ILifecycle
+class INET_API LoRaNodeApp : public cSimpleModule, public ILifecycle, public cListener
 {
     protected:
         virtual void initialize(int stage) override;
@@ -45,17 +72,19 @@ class INET_API LoRaNodeApp : public cSimpleModule, public ILifecycle
         virtual bool handleOperationStage(LifecycleOperation *operation, int stage, IDoneCallback *doneCallback) override;
         virtual bool isNeighbour(int neighbourId);
         virtual bool isRouteInSingleMetricRoutingTable(int id, int via);
-        virtual int  getRouteIndexInSingleMetricRoutingTable(int id, int via);
         virtual bool isRouteInDualMetricRoutingTable(int id, int via, int sf);
-        virtual int  getRouteIndexInDualMetricRoutingTable(int id, int via, int sf);
         virtual bool isKnownNode(int knownNodeId);
         virtual bool isACKed(int nodeId);
         virtual bool isPacketForwarded(cMessage *msg);
         virtual bool isPacketToBeForwarded(cMessage *msg);
         virtual bool isDataPacketForMeUnique(cMessage *msg);
+        uint64_t getPacketKey(int msgType, int source, int destination, int dataInt) const;
+        uint64_t getPacketKey(const LoRaAppPacket *packet) const;
+        uint64_t getPacketKey(const LoRaAppPacketEntry& entry) const;
 
         void handleMessageFromLowerLayer(cMessage *msg);
         void handleSelfMessage(cMessage *msg);
+        virtual void receiveSignal(cComponent *source, simsignal_t signalID, long value, cObject *details) override;
 
         simtime_t getTimeToNextDataPacket();
         simtime_t getTimeToNextRoutingPacket();
@@ -69,13 +98,15 @@ class INET_API LoRaNodeApp : public cSimpleModule, public ILifecycle
         void manageReceivedAckPacketToForward(cMessage *msg);
         void manageReceivedDataPacketToForward(cMessage *msg);
         void manageReceivedRoutingPacket(cMessage *msg);
+        void recordDataPacketReception();
+        void reportDataActivity(bool transmission);
         std::pair<double,double> generateUniformCircleCoordinates(double radius, double gatewayX, double gatewayY);
         void sendJoinRequest();
         void sendDownMgmtPacket();
         void generateDataPackets();
         void sanitizeRoutingTable();
         int pickCADSF(int lowestSF);
-        int getBestRouteIndexTo(int destination);
+        bool hasRouteTo(int destination);
         int getSFTo(int destination);
 
         simtime_t calculateTransmissionDuration(cMessage *msg);
@@ -123,6 +154,8 @@ class INET_API LoRaNodeApp : public cSimpleModule, public ILifecycle
         int lastSentMeasurement;
         int deletedRoutes;
         int forwardBufferFull;
+        int routingPacketSequenceGaps;
+        int macBusyDeferrals;           // self messages that found the MAC busy, each waiting for its macIdle signal
 
         simtime_t timeToFirstRoutingPacket;
         std::string timeToNextRoutingPacketDist;
@@ -165,6 +198,8 @@ class INET_API LoRaNodeApp : public cSimpleModule, public ILifecycle
 
         cMessage *configureLoRaParameters;
         cMessage *selfPacket;
+        LoRaMac *mac;
+        bool waitingForMacIdle;
 
         //history of sent packets;
         cOutVector txSfVector;
@@ -190,15 +225,21 @@ class INET_API LoRaNodeApp : public cSimpleModule, public ILifecycle
         //Packet sizes
         int dataPacketSize;
         int routingPacketMaxSize;
+        int routingPacketHeaderSize;
+        int routingPacketRouteSize;
 
         //Routing variables
         int routingMetric;
+        LoRaRoutingMetric *routing = nullptr;
+        LoRaSingleMetricRouting *singleMetricRouting = nullptr;     // routing, if it keeps a single-metric routing table
+        LoRaDualMetricRouting *dualMetricRouting = nullptr;         // routing, if it keeps a dual-metric routing table
         bool routeDiscovery;
         int windowSize;
         simtime_t routeTimeout;
         bool storeBestRoutesOnly;
         bool getRoutesFromDataPackets;
         simtime_t stopRoutingAfterDataDone;
+        LoRaTerminationCoordinator *terminationCoordinator;
 
         double routingPacketPriority;
         double ownDataPriority;
@@ -210,10 +251,15 @@ class INET_API LoRaNodeApp : public cSimpleModule, public ILifecycle
         std::vector<int> neighbourNodes;
         std::vector<int> knownNodes;
         std::vector<int> ACKedNodes;
-        std::vector<LoRaAppPacket> LoRaPacketsToSend;
-        std::vector<LoRaAppPacket> LoRaPacketsToForward;
-        std::vector<LoRaAppPacket> LoRaPacketsForwarded;
-        std::vector<LoRaAppPacket> DataPacketsForMe;
+        LoRaDataPacketGenerator dataPacketGenerator;
+        std::deque<LoRaAppPacketEntry> LoRaPacketsToForward;
+        std::deque<uint64_t> LoRaPacketsForwarded;     // keys of the last forwardedPacketVectorSize forwarded packets
+
+        // Identity keys (see getPacketKey()) of the packets in LoRaPacketsToForward
+        // and LoRaPacketsForwarded, and of every unique data packet received for me
+        std::unordered_set<uint64_t> packetsToForwardKeys;
+        std::unordered_set<uint64_t> packetsForwardedKeys;
+        std::unordered_set<uint64_t> dataPacketsForMeKeys;
 
 
         //Application parameters
@@ -239,29 +285,119 @@ class INET_API LoRaNodeApp : public cSimpleModule, public ILifecycle
         int packetsToForwardMaxVectorSize;
 
         // Routing tables
-        class singleMetricRoute {
+        typedef LoRaSingleMetricRoute singleMetricRoute;
+        class singleMetricRouteBucket {
 
             public:
-                int id;
-                int via;
-                double metric;
-                int window[33];
-                simtime_t valid;
+                std::vector<singleMetricRoute> routes;
+                int bestRoute = -1;     // cached index of the best route, -1 when it must be recomputed
+        };
+        std::unordered_map<int, singleMetricRouteBucket> singleMetricRoutingTable;
+        int singleMetricRoutesCount;
+
+        typedef LoRaDualMetricRoute dualMetricRoute;
+        class dualMetricRouteBucket {
+
+            public:
+                std::vector<dualMetricRoute> routes;
+                int bestRoute = -1;     // cached index of the best route, -1 when it must be recomputed
         };
-        std::vector<singleMetricRoute> singleMetricRoutingTable;
+        std::unordered_map<int, dualMetricRouteBucket> dualMetricRoutingTable;
+        int dualMetricRoutesCount;
 
-        class dualMetricRoute {
+        // Route expiry min-heap, ordered by validity. Every change of a route's
+        // validity pushes a new entry; outdated ones are skipped when popped.
+        class routeExpiry {
 
             public:
+                simtime_t valid;
                 int id;
                 int via;
-                double priMetric;
-                double secMetric;
-                int window[33];
-                int sf;
+                int sf;     // -1 for single-metric routes
+
+                bool operator>(const routeExpiry& other) const { return valid > other.valid; }
+        };
+        std::priority_queue<routeExpiry, std::vector<routeExpiry>, std::greater<routeExpiry>> routeExpiries;
+
+        // Sequence numbers of the last windowSize routing packets received from
+        // a neighbour, for the ETX metrics. Kept apart from the routes, as only
+        // neighbour routes need one.
+        class etxWindow {
+
+            public:
+                std::vector<int> sequences;     // circular buffer, the newest sequence number at head
+                int head = 0;
+                int sum = 0;
+
+                void reset(int size, int sequence) {
+                    sequences.assign(size, 0);
+                    head = 0;
+                    sequences[head] = sequence;
+                    sum = sequence;
+                }
+                // 1 + sum of (sequence - (window[i] + i + 1)), window[0] being the newest
+                int getETX(int sequence) const {
+                    int size = sequences.size();
+                    return 1 + size * sequence - sum - size * (size + 1) / 2;
+                }
+                // Replaces the oldest sequence number
+                void add(int sequence) {
+                    head = (head + sequences.size() - 1) % sequences.size();
+                    sum += sequence - sequences[head];
+                    sequences[head] = sequence;
+                }
+        };
+        std::unordered_map<int, etxWindow> etxWindows;     // keyed by neighbour and SF, see getETXWindow()
+
+        /**
+         * @name Routing table access
+         * Routes are bucketed by destination; the best route of each bucket is
+         * cached and recomputed only after a route in that bucket was added,
+         * updated or removed (see routeUpdated()).
+         */
+        //@{
+        singleMetricRoute *getRouteInSingleMetricRoutingTable(int id, int via);
+        dualMetricRoute *getRouteInDualMetricRoutingTable(int id, int via, int sf);
+        void addRouteToSingleMetricRoutingTable(const singleMetricRoute& route);
+        void addRouteToDualMetricRoutingTable(const dualMetricRoute& route);
+        void routeUpdated(const singleMetricRoute& route);
+        void routeUpdated(const dualMetricRoute& route);
+        void scheduleRouteExpiry(int id, int via, int sf, simtime_t valid);
+        void removeRouteFromSingleMetricRoutingTable(int id, int via);
+        etxWindow& getETXWindow(int neighbour, int sf);
+        singleMetricRoute *getBestSingleMetricRouteTo(int destination);
+        dualMetricRoute *getBestDualMetricRouteTo(int destination);
+        //@}
+
+        /**
+         * @name Incremental routing packets
+         * With incrementalRoutingPackets, single-SF routing packets only carry
+         * the best routes whose metric changed since the previous one, and
+         * withdrawn routes with a WITHDRAWN_ROUTE_METRIC. Every
+         * fullRoutingPacketInterval-th packet carries the full table instead.
+         * The routing packet sequence number (dataInt) lets receivers detect
+         * lost packets: while in sequence since the last full table, routes
+         * via a neighbour are kept alive by its incremental packets.
+         */
+        //@{
+        class routingNeighbour {
+
+            public:
+                int lastSequence = -1;
+                int fullSequence = -1;      // sequence number of the last full routing table received
+                bool synchronized = false;  // no routing packet lost since the last full routing table
                 simtime_t valid;
         };
-        std::vector<dualMetricRoute> dualMetricRoutingTable;
+        bool incrementalRoutingPackets;
+        int fullRoutingPacketInterval;
+        int routingPacketsSinceFullRefresh;
+        std::unordered_map<int, LoRaRoute> advertisedRoutes;
+        std::unordered_map<int, routingNeighbour> routingNeighbours;
+
+        void addIncrementalRoutesToRoutingPacket(LoRaAppPacket *routingPacket);
+        void updateRoutingNeighbour(const LoRaAppPacket *packet);
+        bool isRouteKeptAliveByNeighbour(const singleMetricRoute& route);
+        //@}
 
 
         /**
@@ -283,6 +419,7 @@ class INET_API LoRaNodeApp : public cSimpleModule, public ILifecycle
 
     public:
         LoRaNodeApp() {}
+        virtual ~LoRaNodeApp() { delete routing; }
         simsignal_t LoRa_AppPacketSent;
         //LoRa physical layer parameters
         double loRaTP;
@@ -0,0 +1,192 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#include <algorithm>
+#include <cmath>
+
+#include "LoRaRoutingMetric.h"
+
+namespace inet {
+
+#define NO_FORWARDING                    0  // No forwarding, no routing.
+#define FLOODING_BROADCAST_SINGLE_SF     1  // Forwarding by flooding, no routing.
+#define SMART_BROADCAST_SINGLE_SF        2  // Forwarding by flooding, no routing, single-hop unicast for last hop if neighbour known.
+#define HOP_COUNT_SINGLE_SF              3  // Next hop routing based on single-SF hop count. In case of a tie, select newest route first.
+#define RSSI_SUM_SINGLE_SF               4  // Next hop routing based on single-SF cumulative RSSI. In case of a tie, select newest route first.
+#define RSSI_PROD_SINGLE_SF              5  // Next hop routing based on single-SF multiplicative RSSI. In case of a tie, select newest route first.
+#define ETX_SINGLE_SF                    6  // Next hop routing based on single-SF ETX. In case of a tie, select newest route first.
+#define TIME_ON_AIR_NEWEST_CAD_MULTI_SF 10  // Next hop routing based on multi-SF ToA. In case of a tie, select newest route first.
+#define TIME_ON_AIR_RANDOM_CAD_MULTI_SF 11  // Next hop routing based on multi-SF ToA. In case of a tie, select randomly between drawing routes.
+#define TIME_ON_AIR_HC_CAD_MULTI_SF     12  // Next hop routing based on multi-SF ToA. In case of a tie, select by minimum hop count between drawing routes. In case of a tie, select newest route first.
+#define TIME_ON_AIR_ETX_CAD_MULTI_SF    13  // Next hop routing based on multi-SF ETX-weighted ToA. In case of a tie, select newest route first.
+#define TIME_ON_AIR_FQUEUE_CAD_MULTI_SF 14  // Next hop routing based on multi-SF queue-length-weighted ToA. In case of a tie, select newest route first.
+#define TIME_ON_AIR_RMP1_CAD_MULTI_SF   15  // Next hop routing based on multi-SF ToA. In case of a tie, select newest route first. Randomly use higher SFs than required.
+
+LoRaRoutingMetric *LoRaRoutingMetric::create(int routingMetric, int numberOfNodes)
+{
+    switch (routingMetric) {
+        case NO_FORWARDING:
+            return new LoRaNoForwarding();
+        case FLOODING_BROADCAST_SINGLE_SF:
+            return new LoRaFloodingBroadcast();
+        case SMART_BROADCAST_SINGLE_SF:
+            return new LoRaSmartBroadcast();
+        case HOP_COUNT_SINGLE_SF:
+            return new LoRaHopCountRouting();
+        case RSSI_SUM_SINGLE_SF:
+            return new LoRaRSSISumRouting();
+        case RSSI_PROD_SINGLE_SF:
+            return new LoRaRSSIProdRouting();
+        case ETX_SINGLE_SF:
+            return new LoRaETXRouting();
+        case TIME_ON_AIR_NEWEST_CAD_MULTI_SF:
+            return new LoRaToANewestRouting();
+        case TIME_ON_AIR_RANDOM_CAD_MULTI_SF:
+            return new LoRaToARandomRouting();
+        case TIME_ON_AIR_HC_CAD_MULTI_SF:
+            return new LoRaToAHopCountRouting();
+        case TIME_ON_AIR_ETX_CAD_MULTI_SF:
+            return new LoRaToAETXRouting();
+        case TIME_ON_AIR_FQUEUE_CAD_MULTI_SF:
+            return new LoRaToAFQueueRouting(numberOfNodes);
+        case TIME_ON_AIR_RMP1_CAD_MULTI_SF:
+            return new LoRaToARMP1Routing();
+        default:
+            throw cRuntimeError("Unknown routing metric %d", routingMetric);
+    }
+}
+
+int LoRaSingleMetricRouting::selectBestRoute(const std::vector<LoRaSingleMetricRoute>& routes) const
+{
+    int bestRoute = 0;
+    int bestMetric = routes[0].metric;
+
+    int routesCount = routes.size();
+    for (int j = 0; j < routesCount; j++) {
+        if (routes[j].metric < bestMetric) {
+            bestMetric = routes[j].metric;
+        }
+    }
+
+    simtime_t lastMetric = 0;
+
+    for (int k = 0; k < routesCount; k++) {
+        if (routes[k].metric == bestMetric) {
+            if (routes[k].valid >= lastMetric) {
+                bestRoute = k;
+                lastMetric = routes[k].valid;
+            }
+        }
+    }
+    return bestRoute;
+}
+
+double LoRaRSSISumRouting::getNeighbourMetric(const LoRaAppPacket *packet, int etx) const
+{
+    return std::abs(packet->getOptions().getRSSI());
+}
+
+double LoRaRSSISumRouting::getRouteMetric(int advertisedMetric, const LoRaAppPacket *packet, double neighbourMetric) const
+{
+    return advertisedMetric + std::abs(packet->getOptions().getRSSI());
+}
+
+double LoRaRSSIProdRouting::getNeighbourMetric(const LoRaAppPacket *packet, int etx) const
+{
+    return std::abs(packet->getOptions().getRSSI());
+}
+
+double LoRaRSSIProdRouting::getRouteMetric(int advertisedMetric, const LoRaAppPacket *packet, double neighbourMetric) const
+{
+    return advertisedMetric * std::abs(packet->getOptions().getRSSI());
+}
+
+double LoRaETXRouting::getNeighbourMetric(const LoRaAppPacket *packet, int etx) const
+{
+    return std::max(1, etx);
+}
+
+double LoRaDualMetricRouting::getNeighbourPriMetric(const LoRaAppPacket *packet, int etx) const
+{
+    return pow(2, packet->getOptions().getLoRaSF() - 7);
+}
+
+int LoRaDualMetricRouting::selectBestRoute(const std::vector<LoRaDualMetricRoute>& routes, cRNG *rng) const
+{
+    int bestRoute = 0;
+
+    int routesCount = routes.size();
+    for (int j = 0; j < routesCount; j++) {
+        if (routes[j].priMetric < routes[bestRoute].priMetric ||
+                ( routes[j].priMetric == routes[bestRoute].priMetric &&
+                        routes[j].secMetric < routes[bestRoute].secMetric) ||
+                        ( routes[j].priMetric == routes[bestRoute].priMetric &&
+                                routes[j].secMetric == routes[bestRoute].secMetric &&
+                                routes[j].valid > routes[bestRoute].valid)) {
+            bestRoute = j;
+        }
+    }
+    return bestRoute;
+}
+
+int LoRaToANewestRouting::selectBestRoute(const std::vector<LoRaDualMetricRoute>& routes, cRNG *rng) const
+{
+    int bestRoute = 0;
+
+    // Find best priMetric with longest validity, no ties expected
+    int routesCount = routes.size();
+    for (int j = 0; j < routesCount; j++) {
+        if ( routes[j].priMetric < routes[bestRoute].priMetric ||
+                ( routes[j].priMetric == routes[bestRoute].priMetric &&
+                        routes[j].valid > routes[bestRoute].valid) ) {
+            bestRoute = j;
+        }
+    }
+    return bestRoute;
+}
+
+int LoRaToARandomRouting::selectBestRoute(const std::vector<LoRaDualMetricRoute>& routes, cRNG *rng) const
+{
+    int bestRoute = 0;
+
+    // Find best priMetric value
+    int routesCount = routes.size();
+    for (int j = 0; j < routesCount; j++) {
+        if (routes[j].priMetric < routes[bestRoute].priMetric) {
+            bestRoute = j;
+        }
+    }
+    // Find ties, and return a random route among them
+    std::vector<int> tieRoutes;
+    for (int j = 0; j < routesCount; j++) {
+        if (routes[j].priMetric == routes[bestRoute].priMetric) {
+            tieRoutes.push_back(j);
+        }
+    }
+    return tieRoutes[intuniform(rng, 0, tieRoutes.size()-1)];
+}
+
+double LoRaToAETXRouting::getNeighbourPriMetric(const LoRaAppPacket *packet, int etx) const
+{
+    int metricValue = pow(2, packet->getOptions().getLoRaSF() - 7);
+    return std::max(metricValue, metricValue*etx);
+}
+
+double LoRaToAFQueueRouting::getNeighbourPriMetric(const LoRaAppPacket *packet, int etx) const
+{
+    return pow(2, packet->getOptions().getLoRaSF() - 7) * ( numberOfNodes/( std::max(numberOfNodes-packet->getBuffer(), numberOfNodes-1)) );
+}
+
+} // namespace inet
@@ -0,0 +1,253 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __LORA_OMNET_LORAROUTINGMETRIC_H_
+#define __LORA_OMNET_LORAROUTINGMETRIC_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+#include "inet/common/INETDefs.h"
+#include "LoRaAppPacket_m.h"
+
+using namespace omnetpp;
+
+namespace inet {
+
+/**
+ * Routing table entry of the single-SF metrics.
+ */
+class LoRaSingleMetricRoute
+{
+    public:
+        int id;
+        int via;
+        double metric;
+        simtime_t valid;
+        int advertisedSequence;     // sequence number of the last routing packet that carried this route
+};
+
+/**
+ * Routing table entry of the multi-SF metrics. Routes are learnt per SF.
+ */
+class LoRaDualMetricRoute
+{
+    public:
+        int id;
+        int via;
+        double priMetric;
+        double secMetric;
+        int sf;
+        simtime_t valid;
+};
+
+/**
+ * Routing metric of a LoRaNodeApp. One instance is created from the
+ * routingMetric parameter at initialization, so the metric-specific parts of
+ * route maintenance and selection are a virtual call instead of a switch on
+ * every packet. A new metric is a new subclass plus a case in create().
+ */
+class INET_API LoRaRoutingMetric
+{
+    public:
+        enum RoutingTable {
+            NO_ROUTING_TABLE,
+            SINGLE_METRIC_ROUTING_TABLE,
+            DUAL_METRIC_ROUTING_TABLE
+        };
+
+        virtual ~LoRaRoutingMetric() {}
+
+        /**
+         * Returns a new instance of the metric with the given routingMetric
+         * identifier. Throws a cRuntimeError if the identifier is unknown.
+         */
+        static LoRaRoutingMetric *create(int routingMetric, int numberOfNodes);
+
+        /** Routing table kept by the node, and sent in its routing packets */
+        virtual RoutingTable getRoutingTable() const = 0;
+
+        /** Whether data packets from other nodes are forwarded */
+        virtual bool isForwarding() const { return true; }
+
+        /** Whether broadcast data packets must be forwarded, whatever routeDiscovery says */
+        virtual bool requiresRouteDiscovery() const { return false; }
+
+        /** Whether neighbour metrics need the ETX of the routing packets received from them */
+        virtual bool usesETX() const { return false; }
+};
+
+/**
+ * Base of the metrics that keep a single-metric routing table.
+ */
+class INET_API LoRaSingleMetricRouting : public LoRaRoutingMetric
+{
+    public:
+        virtual RoutingTable getRoutingTable() const override { return SINGLE_METRIC_ROUTING_TABLE; }
+
+        /**
+         * Metric of the route to the neighbour that sent the routing packet.
+         * etx is that of the neighbour's routing packets, 1 for a new neighbour.
+         */
+        virtual double getNeighbourMetric(const LoRaAppPacket *packet, int etx) const = 0;
+
+        /**
+         * Metric of a route advertised with advertisedMetric in the routing
+         * packet, via a neighbour whose route has neighbourMetric.
+         */
+        virtual double getRouteMetric(int advertisedMetric, const LoRaAppPacket *packet, double neighbourMetric) const = 0;
+
+        /**
+         * Index of the best of the (non-empty) routes to a destination: the
+         * lowest metric, the newest one in case of a tie.
+         */
+        virtual int selectBestRoute(const std::vector<LoRaSingleMetricRoute>& routes) const;
+};
+
+/**
+ * Base of the metrics that keep a dual-metric, per-SF routing table. The
+ * primary metric is the time on air, the secondary one the hop count.
+ */
+class INET_API LoRaDualMetricRouting : public LoRaRoutingMetric
+{
+    public:
+        virtual RoutingTable getRoutingTable() const override { return DUAL_METRIC_ROUTING_TABLE; }
+
+        /**
+         * Primary metric of the route to the neighbour that sent the routing
+         * packet. etx is that of the neighbour's routing packets on the
+         * packet's SF, 1 for a new neighbour.
+         */
+        virtual double getNeighbourPriMetric(const LoRaAppPacket *packet, int etx) const;
+
+        /**
+         * Index of the best of the (non-empty) routes to a destination: the
+         * lowest primary and then secondary metric, the newest one in case of
+         * a tie.
+         */
+        virtual int selectBestRoute(const std::vector<LoRaDualMetricRoute>& routes, cRNG *rng) const;
+
+        /** Whether selectBestRoute() returns the same route until the routes change */
+        virtual bool isBestRouteCacheable() const { return true; }
+
+        /** Whether data packets are sent on a random SF, at least that of their route */
+        virtual bool picksRandomSF() const { return false; }
+};
+
+/** No forwarding, no routing. */
+class INET_API LoRaNoForwarding : public LoRaRoutingMetric
+{
+    public:
+        virtual RoutingTable getRoutingTable() const override { return NO_ROUTING_TABLE; }
+        virtual bool isForwarding() const override { return false; }
+};
+
+/** Forwarding by flooding, no routing. */
+class INET_API LoRaFloodingBroadcast : public LoRaRoutingMetric
+{
+    public:
+        virtual RoutingTable getRoutingTable() const override { return NO_ROUTING_TABLE; }
+};
+
+/** Forwarding by flooding, no routing, single-hop unicast for last hop if neighbour known. */
+class INET_API LoRaSmartBroadcast : public LoRaRoutingMetric
+{
+    public:
+        virtual RoutingTable getRoutingTable() const override { return NO_ROUTING_TABLE; }
+        virtual bool requiresRouteDiscovery() const override { return true; }
+};
+
+/** Single-SF hop count. */
+class INET_API LoRaHopCountRouting : public LoRaSingleMetricRouting
+{
+    public:
+        virtual double getNeighbourMetric(const LoRaAppPacket *packet, int etx) const override { return 1; }
+        virtual double getRouteMetric(int advertisedMetric, const LoRaAppPacket *packet, double neighbourMetric) const override { return advertisedMetric + 1; }
+};
+
+/** Single-SF cumulative RSSI. */
+class INET_API LoRaRSSISumRouting : public LoRaSingleMetricRouting
+{
+    public:
+        virtual double getNeighbourMetric(const LoRaAppPacket *packet, int etx) const override;
+        virtual double getRouteMetric(int advertisedMetric, const LoRaAppPacket *packet, double neighbourMetric) const override;
+};
+
+/** Single-SF multiplicative RSSI. */
+class INET_API LoRaRSSIProdRouting : public LoRaSingleMetricRouting
+{
+    public:
+        virtual double getNeighbourMetric(const LoRaAppPacket *packet, int etx) const override;
+        virtual double getRouteMetric(int advertisedMetric, const LoRaAppPacket *packet, double neighbourMetric) const override;
+};
+
+/** Single-SF ETX. */
+class INET_API LoRaETXRouting : public LoRaSingleMetricRouting
+{
+    public:
+        virtual bool usesETX() const override { return true; }
+        virtual double getNeighbourMetric(const LoRaAppPacket *packet, int etx) const override;
+        virtual double getRouteMetric(int advertisedMetric, const LoRaAppPacket *packet, double neighbourMetric) const override { return neighbourMetric + advertisedMetric; }
+};
+
+/** Multi-SF ToA, the newest route in case of a tie. */
+class INET_API LoRaToANewestRouting : public LoRaDualMetricRouting
+{
+    public:
+        virtual int selectBestRoute(const std::vector<LoRaDualMetricRoute>& routes, cRNG *rng) const override;
+};
+
+/** Multi-SF ToA, a random route in case of a tie. */
+class INET_API LoRaToARandomRouting : public LoRaDualMetricRouting
+{
+    public:
+        virtual int selectBestRoute(const std::vector<LoRaDualMetricRoute>& routes, cRNG *rng) const override;
+        virtual bool isBestRouteCacheable() const override { return false; }
+};
+
+/** Multi-SF ToA, the minimum hop count and then the newest route in case of a tie. */
+class INET_API LoRaToAHopCountRouting : public LoRaDualMetricRouting
+{
+};
+
+/** Multi-SF ETX-weighted ToA. */
+class INET_API LoRaToAETXRouting : public LoRaDualMetricRouting
+{
+    public:
+        virtual bool usesETX() const override { return true; }
+        virtual double getNeighbourPriMetric(const LoRaAppPacket *packet, int etx) const override;
+};
+
+/** Multi-SF queue-length-weighted ToA. */
+class INET_API LoRaToAFQueueRouting : public LoRaDualMetricRouting
+{
+    protected:
+        int numberOfNodes;
+
+    public:
+        LoRaToAFQueueRouting(int numberOfNodes) : numberOfNodes(numberOfNodes) {}
+        virtual double getNeighbourPriMetric(const LoRaAppPacket *packet, int etx) const override;
+};
+
+/** Multi-SF ToA, randomly using higher SFs than required. */
+class INET_API LoRaToARMP1Routing : public LoRaDualMetricRouting
+{
+    public:
+        virtual bool picksRandomSF() const override { return true; }
+};
+
+} // namespace inet
+
+#endif
@@ -0,0 +1,104 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "LoRaTerminationCoordinator.h"
+
+namespace inet {
+
+Define_Module(LoRaTerminationCoordinator);
+
+LoRaTerminationCoordinator::LoRaTerminationCoordinator() :
+    numberOfNodes(0),
+    endSimulationWhenDone(false),
+    transmittingNodes(0),
+    doneTime(0),
+    routingDoneTime(0),
+    doneTimer(nullptr)
+{
+}
+
+LoRaTerminationCoordinator::~LoRaTerminationCoordinator()
+{
+    cancelAndDelete(doneTimer);
+}
+
+void LoRaTerminationCoordinator::initialize()
+{
+    numberOfNodes = par("numberOfNodes");
+    endSimulationWhenDone = par("endSimulationWhenDone");
+    nodeTransmitted.assign(numberOfNodes, false);
+    doneTimer = new cMessage("doneTimer");
+    routingDoneSignal = registerSignal("routingDone");
+    WATCH(transmittingNodes);
+    WATCH(doneTime);
+}
+
+void LoRaTerminationCoordinator::handleMessage(cMessage *msg)
+{
+    if (msg != doneTimer)
+        throw cRuntimeError("Unknown message: %s", msg->getName());
+
+    // The timer is moved forward whenever doneTime grows, so at this point
+    // no node has been active since
+    if (isRoutingDone() && routingDoneTime == 0) {
+        routingDoneTime = simTime();
+        emit(routingDoneSignal, true);
+        if (endSimulationWhenDone)
+            endSimulation();
+    }
+}
+
+void LoRaTerminationCoordinator::finish()
+{
+    recordScalar("transmittingNodes", transmittingNodes);
+    recordScalar("routingDoneTime", routingDoneTime);
+}
+
+void LoRaTerminationCoordinator::reportDataActivity(int nodeId, bool transmission, simtime_t stopRoutingAfterDataDone)
+{
+    Enter_Method_Silent();
+
+    if (nodeId < 0 || nodeId >= numberOfNodes)
+        throw cRuntimeError("Node %d out of range, numberOfNodes is %d", nodeId, numberOfNodes);
+
+    if (transmission && !nodeTransmitted[nodeId]) {
+        nodeTransmitted[nodeId] = true;
+        transmittingNodes++;
+    }
+    if (simTime() + stopRoutingAfterDataDone > doneTime)
+        doneTime = simTime() + stopRoutingAfterDataDone;
+    scheduleDoneTimer();
+}
+
+bool LoRaTerminationCoordinator::isRoutingDone() const
+{
+    return transmittingNodes == numberOfNodes && doneTime < simTime();
+}
+
+void LoRaTerminationCoordinator::scheduleDoneTimer()
+{
+    if (transmittingNodes < numberOfNodes || routingDoneTime != 0)
+        return;
+    // isRoutingDone() requires doneTime to be strictly in the past
+    simtime_t timerTime = doneTime + SimTime().setRaw(1);
+    if (doneTimer->isScheduled()) {
+        if (doneTimer->getArrivalTime() == timerTime)
+            return;
+        cancelEvent(doneTimer);
+    }
+    scheduleAt(timerTime, doneTimer);
+}
+
+}
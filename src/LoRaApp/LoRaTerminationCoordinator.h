@@ -0,0 +1,76 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef __LORA_OMNET_LORATERMINATIONCOORDINATOR_H_
+#define __LORA_OMNET_LORATERMINATIONCOORDINATOR_H_
+
+#include <omnetpp.h>
+#include <vector>
+
+#include "inet/common/INETDefs.h"
+
+using namespace omnetpp;
+
+namespace inet {
+
+/**
+ * Network-wide bookkeeping of the data activity of all LoRaNodeApps, used to
+ * decide when routing can stop once every node is done with its data
+ * packets. A node is done when it has transmitted at least one data packet
+ * and stopRoutingAfterDataDone has elapsed since its last data packet
+ * transmission and reception. Nodes report their activity as it happens, so
+ * the check is O(1) instead of a scan of every node on every event.
+ */
+class INET_API LoRaTerminationCoordinator : public cSimpleModule
+{
+    protected:
+        int numberOfNodes;
+        bool endSimulationWhenDone;
+
+        std::vector<bool> nodeTransmitted;
+        int transmittingNodes;
+        // Latest time at which any node may still be considered active
+        simtime_t doneTime;
+        simtime_t routingDoneTime;
+
+        cMessage *doneTimer;
+        simsignal_t routingDoneSignal;
+
+    protected:
+        virtual void initialize() override;
+        virtual void handleMessage(cMessage *msg) override;
+        virtual void finish() override;
+
+        void scheduleDoneTimer();
+
+    public:
+        LoRaTerminationCoordinator();
+        virtual ~LoRaTerminationCoordinator();
+
+        /**
+         * Records a data packet transmission (or reception, if transmission
+         * is false) of node nodeId at the current simulation time.
+         */
+        void reportDataActivity(int nodeId, bool transmission, simtime_t stopRoutingAfterDataDone);
+
+        /**
+         * Returns true when every node is done with its data packets.
+         */
+        bool isRoutingDone() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,64 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef LORAPHY_ILORAPATHLOSS_H_
+#define LORAPHY_ILORAPATHLOSS_H_
+
+#include "inet/physicallayer/contract/packetlevel/IPathLoss.h"
+
+namespace inet {
+
+namespace physicallayer {
+
+/**
+ * This interface splits the LoRa path loss models into a deterministic mean
+ * path loss, which only depends on the distance, and a random shadowing term
+ * drawn for each transmission. Multiplying both gives the same path loss as
+ * computePathLoss().
+ */
+class INET_API ILoRaPathLoss
+{
+  public:
+    virtual ~ILoRaPathLoss() {}
+
+    /**
+     * Returns the path loss without shadowing as a fraction in [0, +infinity).
+     */
+    virtual double computeMeanPathLoss(m distance) const = 0;
+
+    /**
+     * Draws the shadowing of a single transmission as a fraction, returns 1
+     * if the model has no shadowing.
+     */
+    virtual double computeShadowing() const = 0;
+
+    /**
+     * Returns the distance where the mean path loss, without shadowing,
+     * brings the transmission power down to the given sensitivity.
+     */
+    virtual m computeRange(W transmissionPower, W sensitivity) const = 0;
+
+    /**
+     * Returns the standard deviation of the shadowing in dB, 0 if the model
+     * has no shadowing.
+     */
+    virtual double getShadowingSigma() const = 0;
+};
+
+} // namespace physicallayer
+
+} // namespace inet
+
+#endif /* LORAPHY_ILORAPATHLOSS_H_ */
@@ -21,6 +21,9 @@
 #include "LoRaTransmission.h"
 #include "LoRaReceiver.h"
 #include "LoRa/LoRaRadio.h"
+#include "LoRaMedium.h"
+#include "ILoRaPathLoss.h"
+#include "LoRaPhyTables.h"
 
 namespace inet {
 
@@ -36,73 +39,36 @@ std::ostream& LoRaAnalogModel::printToStream(std::ostream& stream, int level) co
 const W LoRaAnalogModel::getBackgroundNoisePower(const LoRaBandListening *listening) const {
     //const LoRaBandListening *loRaListening = check_and_cast<const LoRaBandListening *>(listening);
     //Sensitivity values from Semtech SX1272/73 datasheet, table 10, Rev 3.1, March 2017
-    W noisePower = W(math::dBm2mW(-126.5) / 1000);
-    if(listening->getLoRaSF() == 6)
-    {
-        if(listening->getLoRaBW() == Hz(125000)) noisePower = W(math::dBm2mW(-121) / 1000);
-        if(listening->getLoRaBW() == Hz(250000)) noisePower = W(math::dBm2mW(-118) / 1000);
-        if(listening->getLoRaBW() == Hz(500000)) noisePower = W(math::dBm2mW(-111) / 1000);
-    }
-
-    if (listening->getLoRaSF() == 7)
-    {
-        if(listening->getLoRaBW() == Hz(125000)) noisePower = W(math::dBm2mW(-124) / 1000);
-        if(listening->getLoRaBW() == Hz(250000)) noisePower = W(math::dBm2mW(-122) / 1000);
-        if(listening->getLoRaBW() == Hz(500000)) noisePower = W(math::dBm2mW(-116) / 1000);
-    }
-
-    if(listening->getLoRaSF() == 8)
-    {
-        if(listening->getLoRaBW() == Hz(125000)) noisePower = W(math::dBm2mW(-127) / 1000);
-        if(listening->getLoRaBW() == Hz(250000)) noisePower = W(math::dBm2mW(-125) / 1000);
-        if(listening->getLoRaBW() == Hz(500000)) noisePower = W(math::dBm2mW(-119) / 1000);
-    }
-    if(listening->getLoRaSF() == 9)
-    {
-        if(listening->getLoRaBW() == Hz(125000)) noisePower = W(math::dBm2mW(-130) / 1000);
-        if(listening->getLoRaBW() == Hz(250000)) noisePower = W(math::dBm2mW(-128) / 1000);
-        if(listening->getLoRaBW() == Hz(500000)) noisePower = W(math::dBm2mW(-122) / 1000);
-    }
-    if(listening->getLoRaSF() == 10)
-    {
-        if(listening->getLoRaBW() == Hz(125000)) noisePower = W(math::dBm2mW(-133) / 1000);
-        if(listening->getLoRaBW() == Hz(250000)) noisePower = W(math::dBm2mW(-130) / 1000);
-        if(listening->getLoRaBW() == Hz(500000)) noisePower = W(math::dBm2mW(-125) / 1000);
-    }
-    if(listening->getLoRaSF() == 11)
-    {
-        if(listening->getLoRaBW() == Hz(125000)) noisePower = W(math::dBm2mW(-135) / 1000);
-        if(listening->getLoRaBW() == Hz(250000)) noisePower = W(math::dBm2mW(-132) / 1000);
-        if(listening->getLoRaBW() == Hz(500000)) noisePower = W(math::dBm2mW(-128) / 1000);
-    }
-    if(listening->getLoRaSF() == 12)
-    {
-        if(listening->getLoRaBW() == Hz(125000)) noisePower = W(math::dBm2mW(-137) / 1000);
-        if(listening->getLoRaBW() == Hz(250000)) noisePower = W(math::dBm2mW(-135) / 1000);
-        if(listening->getLoRaBW() == Hz(500000)) noisePower = W(math::dBm2mW(-129) / 1000);
-    }
-    return noisePower;
+    return LoRaPhyTables::getBackgroundNoisePower(listening->getLoRaSF(), listening->getLoRaBW());
 }
 
 W LoRaAnalogModel::computeReceptionPower(const IRadio *receiverRadio, const ITransmission *transmission, const IArrival *arrival) const
 {
     const IRadioMedium *radioMedium = receiverRadio->getMedium();
     const IRadio *transmitterRadio = transmission->getTransmitter();
-    const IAntenna *receiverAntenna = receiverRadio->getAntenna();
-    const IAntenna *transmitterAntenna = transmitterRadio->getAntenna();
     const INarrowbandSignal *narrowbandSignalAnalogModel = check_and_cast<const INarrowbandSignal *>(transmission->getAnalogModel());
     const IScalarSignal *scalarSignalAnalogModel = check_and_cast<const IScalarSignal *>(transmission->getAnalogModel());
     const Coord receptionStartPosition = arrival->getStartPosition();
-    const Coord receptionEndPosition = arrival->getEndPosition();
-    const EulerAngles transmissionDirection = computeTransmissionDirection(transmission, arrival);
-    const EulerAngles transmissionAntennaDirection = transmission->getStartOrientation() - transmissionDirection;
-    const EulerAngles receptionAntennaDirection = transmissionDirection - arrival->getStartOrientation();
-    double transmitterAntennaGain = transmitterAntenna->computeGain(transmissionAntennaDirection);
-    double receiverAntennaGain = receiverAntenna->computeGain(receptionAntennaDirection);
-    double pathLoss = radioMedium->getPathLoss()->computePathLoss(transmission, arrival);
+    double linkGain;
+    const LoRaMedium *loRaMedium = dynamic_cast<const LoRaMedium *>(radioMedium);
+    // the link budget table already includes both antenna gains
+    double meanPathLoss = loRaMedium != nullptr ? loRaMedium->getMeanPathLoss(transmitterRadio, receiverRadio) : NaN;
+    if (!std::isnan(meanPathLoss))
+        linkGain = meanPathLoss * check_and_cast<const ILoRaPathLoss *>(radioMedium->getPathLoss())->computeShadowing();
+    else {
+        const IAntenna *receiverAntenna = receiverRadio->getAntenna();
+        const IAntenna *transmitterAntenna = transmitterRadio->getAntenna();
+        const EulerAngles transmissionDirection = computeTransmissionDirection(transmission, arrival);
+        const EulerAngles transmissionAntennaDirection = transmission->getStartOrientation() - transmissionDirection;
+        const EulerAngles receptionAntennaDirection = transmissionDirection - arrival->getStartOrientation();
+        double transmitterAntennaGain = transmitterAntenna->computeGain(transmissionAntennaDirection);
+        double receiverAntennaGain = receiverAntenna->computeGain(receptionAntennaDirection);
+        double pathLoss = radioMedium->getPathLoss()->computePathLoss(transmission, arrival);
+        linkGain = transmitterAntennaGain * receiverAntennaGain * pathLoss;
+    }
     double obstacleLoss = radioMedium->getObstacleLoss() ? radioMedium->getObstacleLoss()->computeObstacleLoss(narrowbandSignalAnalogModel->getCarrierFrequency(), transmission->getStartPosition(), receptionStartPosition) : 1;
     W transmissionPower = scalarSignalAnalogModel->getPower();
-    return transmissionPower * std::min(1.0, transmitterAntennaGain * receiverAntennaGain * pathLoss * obstacleLoss);
+    return transmissionPower * std::min(1.0, linkGain * obstacleLoss);
 }
 
 const IReception *LoRaAnalogModel::computeReception(const IRadio *receiverRadio, const ITransmission *transmission, const IArrival *arrival) const
@@ -0,0 +1,97 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+#include "LoRaPhy/LoRaCommunicationCache.h"
+#include <algorithm>
+
+namespace inet {
+
+namespace physicallayer {
+
+Define_Module(LoRaCommunicationCache);
+
+void LoRaCommunicationCache::removeRadio(const IRadio *radio)
+{
+    VectorCommunicationCache::removeRadio(radio);
+    receiverIntervals.erase(radio->getId());
+}
+
+void LoRaCommunicationCache::removeNonInterferingTransmissions()
+{
+    VectorCommunicationCache::removeNonInterferingTransmissions();
+    const simtime_t now = simTime();
+    for (auto& it : receiverIntervals) {
+        ReceiverIntervals& entry = it.second;
+        // a transmission is removed once the longest transmission could have
+        // arrived after it ended, so its intervals ended by now minus the
+        // longest duration, and no ongoing reception reaches back that far
+        simtime_t expiredEndTime = now - entry.maxDuration;
+        if (expiredEndTime > entry.expiredEndTime)
+            entry.expiredEndTime = expiredEndTime;
+        // only the prefix is erased, the expired intervals behind a longer
+        // one are skipped by the queries until they get to the front
+        std::vector<ArrivalInterval>& intervals = entry.intervals;
+        auto last = intervals.begin();
+        while (last != intervals.end() && last->endTime <= entry.expiredEndTime)
+            last++;
+        intervals.erase(intervals.begin(), last);
+    }
+}
+
+void LoRaCommunicationCache::addArrivalInterval(const IRadio *receiver, const ITransmission *transmission, simtime_t startTime, simtime_t endTime)
+{
+    ReceiverIntervals& entry = receiverIntervals[receiver->getId()];
+    std::vector<ArrivalInterval>& intervals = entry.intervals;
+    ArrivalInterval interval = {startTime, endTime, transmission};
+    // arrivals are mostly added in start time order, so this usually appends
+    auto it = intervals.end();
+    while (it != intervals.begin() && (it - 1)->startTime > startTime)
+        it--;
+    intervals.insert(it, interval);
+    if (endTime - startTime > entry.maxDuration)
+        entry.maxDuration = endTime - startTime;
+}
+
+std::vector<const ITransmission *> *LoRaCommunicationCache::computeInterferingTransmissions(const IRadio *radio, const simtime_t startTime, const simtime_t endTime)
+{
+    std::vector<const ITransmission *> *interferingTransmissions = new std::vector<const ITransmission *>();
+    computeInterferingTransmissions(radio, startTime, endTime, *interferingTransmissions);
+    return interferingTransmissions;
+}
+
+void LoRaCommunicationCache::computeInterferingTransmissions(const IRadio *radio, const simtime_t startTime, const simtime_t endTime, std::vector<const ITransmission *>& interferingTransmissions) const
+{
+    interferingTransmissions.clear();
+    auto it = receiverIntervals.find(radio->getId());
+    if (it == receiverIntervals.end())
+        return;
+    const ReceiverIntervals& entry = it->second;
+    const std::vector<ArrivalInterval>& intervals = entry.intervals;
+    // intervals starting after the end can't overlap, and intervals starting
+    // more than the longest duration before the start have already ended
+    auto last = std::upper_bound(intervals.begin(), intervals.end(), endTime, [] (const simtime_t time, const ArrivalInterval& interval) {
+        return time < interval.startTime;
+    });
+    simtime_t minStartTime = startTime - entry.maxDuration;
+    auto first = last;
+    while (first != intervals.begin() && (first - 1)->startTime >= minStartTime)
+        first--;
+    for (auto jt = first; jt != last; jt++)
+        if (jt->endTime >= startTime && jt->endTime > entry.expiredEndTime)
+            interferingTransmissions.push_back(jt->transmission);
+}
+
+} // namespace physicallayer
+
+} // namespace inet
@@ -0,0 +1,87 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+#ifndef LORAPHY_LORACOMMUNICATIONCACHE_H_
+#define LORAPHY_LORACOMMUNICATIONCACHE_H_
+
+#include "inet/physicallayer/common/packetlevel/VectorCommunicationCache.h"
+#include <unordered_map>
+#include <vector>
+
+namespace inet {
+
+namespace physicallayer {
+
+/**
+ * This communication cache extends the vector based cache with a separate
+ * interval index for each receiver. The index stores the arrival intervals
+ * by value sorted by start time, and queries fill a buffer provided by the
+ * caller, so that neither inserting nor querying allocates per call.
+ */
+class INET_API LoRaCommunicationCache : public VectorCommunicationCache
+{
+  protected:
+    struct ArrivalInterval
+    {
+        simtime_t startTime;
+        simtime_t endTime;
+        const ITransmission *transmission;
+    };
+
+    struct ReceiverIntervals
+    {
+        /**
+         * Arrival intervals sorted by start time.
+         */
+        std::vector<ArrivalInterval> intervals;
+        /**
+         * The longest interval ever added, bounds how far back a query has
+         * to look from the end of the queried interval.
+         */
+        simtime_t maxDuration;
+        /**
+         * Intervals ending at or before this time may belong to removed
+         * transmissions, so queries never report them.
+         */
+        simtime_t expiredEndTime;
+    };
+
+  protected:
+    /**
+     * The arrival intervals of each receiver indexed by the radio id.
+     */
+    std::unordered_map<int, ReceiverIntervals> receiverIntervals;
+
+  public:
+    virtual void removeRadio(const IRadio *radio) override;
+    virtual void removeNonInterferingTransmissions() override;
+
+    /**
+     * Records the arrival interval of the transmission at the receiver.
+     */
+    virtual void addArrivalInterval(const IRadio *receiver, const ITransmission *transmission, simtime_t startTime, simtime_t endTime);
+
+    virtual std::vector<const ITransmission *> *computeInterferingTransmissions(const IRadio *radio, const simtime_t startTime, const simtime_t endTime) override;
+    /**
+     * Appends the transmissions arriving at the radio in the closed interval
+     * [startTime, endTime] to the provided buffer after clearing it.
+     */
+    virtual void computeInterferingTransmissions(const IRadio *radio, const simtime_t startTime, const simtime_t endTime, std::vector<const ITransmission *>& interferingTransmissions) const;
+};
+
+} // namespace physicallayer
+
+} // namespace inet
+
+#endif /* LORAPHY_LORACOMMUNICATIONCACHE_H_ */
@@ -41,10 +41,30 @@ std::ostream& LoRaHataOkumura::printToStream(std::ostream& stream, int level) co
 }
 
 double LoRaHataOkumura::computePathLoss(mps propagationSpeed, Hz frequency, m distance) const
+{
+    return computeMeanPathLoss(distance);
+}
+
+double LoRaHataOkumura::computeMeanPathLossDb(double distance) const
 {
     // build based on documentation from Actility
-    double PL_db = K1 + K2 * log10(distance.get()/1000);
-    return math::dB2fraction(-PL_db);
+    return K1 + K2 * log10(distance/1000);
+}
+
+double LoRaHataOkumura::computeMeanPathLoss(m distance) const
+{
+    return math::dB2fraction(-computeMeanPathLossDb(distance.get()));
+}
+
+double LoRaHataOkumura::computeShadowing() const
+{
+    return 1;
+}
+
+m LoRaHataOkumura::computeRange(W transmissionPower, W sensitivity) const
+{
+    double PL_db = math::fraction2dB(transmissionPower.get() / sensitivity.get());
+    return m(1000 * pow(10, (PL_db - K1) / K2));
 }
 
 }
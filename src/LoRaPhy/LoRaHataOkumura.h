@@ -17,6 +17,7 @@
 #define LORAPHY_LORAHATAOKUMURA_H_
 
 #include "inet/physicallayer/pathloss/FreeSpacePathLoss.h"
+#include "LoRaPhy/ILoRaPathLoss.h"
 
 namespace inet {
 
@@ -25,7 +26,7 @@ namespace physicallayer {
 /**
  * This class implements the LoRaHataOkumura.
  */
-class INET_API LoRaHataOkumura : public FreeSpacePathLoss
+class INET_API LoRaHataOkumura : public FreeSpacePathLoss, public ILoRaPathLoss
 {
   protected:
     double K1;
@@ -33,11 +34,16 @@ class INET_API LoRaHataOkumura : public FreeSpacePathLoss
 
   protected:
     virtual void initialize(int stage) override;
+    double computeMeanPathLossDb(double distance) const;
 
   public:
     LoRaHataOkumura();
     virtual std::ostream& printToStream(std::ostream& stream, int level) const override;
     virtual double computePathLoss(mps propagationSpeed, Hz frequency, m distance) const override;
+    virtual double computeMeanPathLoss(m distance) const override;
+    virtual double computeShadowing() const override;
+    virtual m computeRange(W transmissionPower, W sensitivity) const override;
+    virtual double getShadowingSigma() const override { return 0; }
 };
 
 } // namespace physicallayer
@@ -0,0 +1,57 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+#include "LoRaPhy/LoRaInterference.h"
+
+namespace inet {
+
+namespace physicallayer {
+
+LoRaInterferingReceptionsPool::~LoRaInterferingReceptionsPool()
+{
+    for (auto interferingReceptions : vectors)
+        delete interferingReceptions;
+}
+
+std::vector<const IReception *> *LoRaInterferingReceptionsPool::acquire()
+{
+    if (vectors.empty())
+        return new std::vector<const IReception *>();
+    std::vector<const IReception *> *interferingReceptions = vectors.back();
+    vectors.pop_back();
+    return interferingReceptions;
+}
+
+void LoRaInterferingReceptionsPool::release(std::vector<const IReception *> *interferingReceptions)
+{
+    interferingReceptions->clear();
+    vectors.push_back(interferingReceptions);
+}
+
+LoRaInterference::LoRaInterference(const INoise *noise, std::vector<const IReception *> *interferingReceptions, const std::shared_ptr<LoRaInterferingReceptionsPool>& interferingReceptionsPool) :
+    Interference(noise, interferingReceptions),
+    interferingReceptionsPool(interferingReceptionsPool)
+{
+}
+
+LoRaInterference::~LoRaInterference()
+{
+    interferingReceptionsPool->release(const_cast<std::vector<const IReception *> *>(interferingReceptions));
+    // Interference would delete it otherwise
+    interferingReceptions = nullptr;
+}
+
+} // namespace physicallayer
+
+} // namespace inet
@@ -0,0 +1,67 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+#ifndef LORAPHY_LORAINTERFERENCE_H_
+#define LORAPHY_LORAINTERFERENCE_H_
+
+#include "inet/physicallayer/common/packetlevel/Interference.h"
+#include <memory>
+#include <vector>
+
+namespace inet {
+
+namespace physicallayer {
+
+/**
+ * Spare interfering reception vectors, which keep their capacity between
+ * interferences so that filling one doesn't allocate in the steady state.
+ */
+class INET_API LoRaInterferingReceptionsPool
+{
+  protected:
+    std::vector<std::vector<const IReception *> *> vectors;
+
+  public:
+    ~LoRaInterferingReceptionsPool();
+
+    /**
+     * Returns an empty vector, either a spare one or a new one.
+     */
+    std::vector<const IReception *> *acquire();
+    /**
+     * Takes back the vector for later reuse.
+     */
+    void release(std::vector<const IReception *> *interferingReceptions);
+};
+
+/**
+ * This interference returns its interfering receptions to the pool they were
+ * acquired from instead of deleting them. The pool is shared, because cached
+ * interferences may be deleted by the communication cache after the medium.
+ */
+class INET_API LoRaInterference : public Interference
+{
+  protected:
+    std::shared_ptr<LoRaInterferingReceptionsPool> interferingReceptionsPool;
+
+  public:
+    LoRaInterference(const INoise *noise, std::vector<const IReception *> *interferingReceptions, const std::shared_ptr<LoRaInterferingReceptionsPool>& interferingReceptionsPool);
+    virtual ~LoRaInterference();
+};
+
+} // namespace physicallayer
+
+} // namespace inet
+
+#endif /* LORAPHY_LORAINTERFERENCE_H_ */
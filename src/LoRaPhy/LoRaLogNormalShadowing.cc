@@ -49,8 +49,7 @@ std::ostream& LoRaLogNormalShadowing::printToStream(std::ostream& stream, int le
 double LoRaLogNormalShadowing::computePathLoss(mps propagationSpeed, Hz frequency, m distance) const
 {
     // parameters taken from paper "Do LoRa Low-Power Wide-Area Networks Scale?"
-    double PL_d0_db = 127.41;
-    double PL_db = PL_d0_db + 10 * gamma * log10(unit(distance / d0).get()) + normal(0.0, sigma);
+    double PL_db = computeMeanPathLossDb(distance.get()) + normal(0.0, sigma);
     return math::dB2fraction(-PL_db);
 }
 
@@ -66,6 +65,29 @@ m LoRaLogNormalShadowing::computeRange(W transmissionPower) const
     return m(distance);
 }
 
+double LoRaLogNormalShadowing::computeMeanPathLossDb(double distance) const
+{
+    // parameters taken from paper "Do LoRa Low-Power Wide-Area Networks Scale?"
+    double PL_d0_db = 127.41;
+    return PL_d0_db + 10 * gamma * log10(distance / d0.get());
+}
+
+double LoRaLogNormalShadowing::computeMeanPathLoss(m distance) const
+{
+    return math::dB2fraction(-computeMeanPathLossDb(distance.get()));
+}
+
+double LoRaLogNormalShadowing::computeShadowing() const
+{
+    return math::dB2fraction(-normal(0.0, sigma));
+}
+
+m LoRaLogNormalShadowing::computeRange(W transmissionPower, W sensitivity) const
+{
+    double PL_d0_db = 127.41;
+    double PL_db = math::fraction2dB(transmissionPower.get() / sensitivity.get());
+    return d0 * pow(10, (PL_db - PL_d0_db) / (10 * gamma));
+}
 
 }
 
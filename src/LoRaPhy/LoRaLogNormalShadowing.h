@@ -17,6 +17,7 @@
 #define LORAPHY_LORALOGNORMALSHADOWING_H_
 
 #include "inet/physicallayer/pathloss/FreeSpacePathLoss.h"
+#include "LoRaPhy/ILoRaPathLoss.h"
 
 namespace inet {
 
@@ -25,7 +26,7 @@ namespace physicallayer {
 /**
  * This class implements the log normal shadowing model.
  */
-class INET_API LoRaLogNormalShadowing : public FreeSpacePathLoss
+class INET_API LoRaLogNormalShadowing : public FreeSpacePathLoss, public ILoRaPathLoss
 {
   protected:
     m d0;
@@ -34,6 +35,7 @@ class INET_API LoRaLogNormalShadowing : public FreeSpacePathLoss
 
   protected:
     virtual void initialize(int stage) override;
+    double computeMeanPathLossDb(double distance) const;
 
   public:
     LoRaLogNormalShadowing();
@@ -41,6 +43,10 @@ class INET_API LoRaLogNormalShadowing : public FreeSpacePathLoss
     //virtual double computePathLoss(const ITransmission *transmission, const IArrival *arrival) const override;
     virtual double computePathLoss(mps propagationSpeed, Hz frequency, m distance) const override;
     m computeRange(W transmissionPower) const;
+    virtual double computeMeanPathLoss(m distance) const override;
+    virtual double computeShadowing() const override;
+    virtual m computeRange(W transmissionPower, W sensitivity) const override;
+    virtual double getShadowingSigma() const override { return sigma; }
 };
 
 } // namespace physicallayer
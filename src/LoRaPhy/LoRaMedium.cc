@@ -21,6 +21,8 @@
 #include "inet/physicallayer/common/packetlevel/Interference.h"
 #include "inet/physicallayer/common/packetlevel/Radio.h"
 #include "inet/physicallayer/common/packetlevel/RadioMedium.h"
+#include "inet/physicallayer/antenna/IsotropicAntenna.h"
+#include "LoRaPhy/ILoRaPathLoss.h"
 namespace inet {
 namespace physicallayer {
 Define_Module(LoRaMedium);
@@ -37,10 +39,20 @@ LoRaMedium::LoRaMedium() :
     listeningFilter(false),
     macAddressFilter(false),
     recordCommunicationLog(false),
+    useSpatialIndex(false),
+    useLinkBudgetTable(false),
     removeNonInterferingTransmissionsTimer(nullptr),
+    spatialIndexCellSize(NaN),
+    spatialIndexInvalid(true),
+    spatialIndexUnusableWarned(false),
+    linkBudgetTableBaseId(-1),
+    linkBudgetTableSize(0),
+    linkBudgetTableInvalid(true),
     mediumLimitCache(nullptr),
     neighborCache(nullptr),
     communicationCache(nullptr),
+    loRaCommunicationCache(nullptr),
+    interferingReceptionsPool(std::make_shared<LoRaInterferingReceptionsPool>()),
     transmissionCount(0),
     radioFrameSendCount(0),
     receptionComputationCount(0),
@@ -58,12 +70,18 @@ LoRaMedium::LoRaMedium() :
     cacheDecisionGetCount(0),
     cacheDecisionHitCount(0),
     cacheResultGetCount(0),
-    cacheResultHitCount(0)
+    cacheResultHitCount(0),
+    spatialIndexSkipCount(0),
+    linkBudgetTableHitCount(0),
+    cacheCurrentInterferenceGetCount(0),
+    cacheCurrentInterferenceHitCount(0)
 {
 }
 LoRaMedium::~LoRaMedium()
 {
     cancelAndDelete(removeNonInterferingTransmissionsTimer);
+    for (const auto& entry : currentInterferences)
+        delete entry.second.first;
     for (const auto transmission : transmissions) {
         delete communicationCache->getCachedFrame(transmission);
         delete transmission;
@@ -83,6 +101,7 @@ void LoRaMedium::initialize(int stage)
         mediumLimitCache = check_and_cast<IMediumLimitCache *>(getSubmodule("mediumLimitCache"));
         neighborCache = dynamic_cast<INeighborCache *>(getSubmodule("neighborCache"));
         communicationCache = check_and_cast<ICommunicationCache *>(getSubmodule("communicationCache"));
+        loRaCommunicationCache = dynamic_cast<LoRaCommunicationCache *>(communicationCache);
         physicalEnvironment = dynamic_cast<IPhysicalEnvironment *>(getModuleByPath(par("physicalEnvironmentModule")));
         material = physicalEnvironment != nullptr ? physicalEnvironment->getMaterialRegistry()->getMaterial("air") : nullptr;
         const char *rangeFilterString = par("rangeFilter");
@@ -97,6 +116,8 @@ void LoRaMedium::initialize(int stage)
         radioModeFilter = par("radioModeFilter");
         listeningFilter = par("listeningFilter");
         macAddressFilter = par("macAddressFilter");
+        useSpatialIndex = par("useSpatialIndex");
+        useLinkBudgetTable = par("useLinkBudgetTable");
         // initialize timers
         removeNonInterferingTransmissionsTimer = new cMessage("removeNonInterferingTransmissions");
         // initialize logging
@@ -115,6 +136,7 @@ void LoRaMedium::finish()
     double snirCacheHitPercentage = 100 * (double)cacheSNIRHitCount / (double)cacheSNIRGetCount;
     double decisionCacheHitPercentage = 100 * (double)cacheDecisionHitCount / (double)cacheDecisionGetCount;
     double resultCacheHitPercentage = 100 * (double)cacheResultHitCount / (double)cacheResultGetCount;
+    double currentInterferenceCacheHitPercentage = 100 * (double)cacheCurrentInterferenceHitCount / (double)cacheCurrentInterferenceGetCount;
     EV_INFO << "Transmission count = " << transmissionCount << endl;
     EV_INFO << "Radio frame send count = " << radioFrameSendCount << endl;
     EV_INFO << "Reception computation count = " << receptionComputationCount << endl;
@@ -127,6 +149,9 @@ void LoRaMedium::finish()
     EV_INFO << "SNIR cache hit = " << snirCacheHitPercentage << " %" << endl;
     EV_INFO << "Reception decision cache hit = " << decisionCacheHitPercentage << " %" << endl;
     EV_INFO << "Reception result cache hit = " << resultCacheHitPercentage << " %" << endl;
+    EV_INFO << "Current interference cache hit = " << currentInterferenceCacheHitPercentage << " %" << endl;
+    EV_INFO << "Spatial index skip count = " << spatialIndexSkipCount << endl;
+    EV_INFO << "Link budget table hit count = " << linkBudgetTableHitCount << endl;
     recordScalar("transmission count", transmissionCount);
     recordScalar("radio frame send count", radioFrameSendCount);
     recordScalar("reception computation count", receptionComputationCount);
@@ -139,6 +164,9 @@ void LoRaMedium::finish()
     recordScalar("snir cache hit", snirCacheHitPercentage, "%");
     recordScalar("reception decision cache hit", decisionCacheHitPercentage, "%");
     recordScalar("reception result cache hit", resultCacheHitPercentage, "%");
+    recordScalar("current interference cache hit", currentInterferenceCacheHitPercentage, "%");
+    recordScalar("spatial index skip count", spatialIndexSkipCount);
+    recordScalar("link budget table hit count", linkBudgetTableHitCount);
 }
 std::ostream& LoRaMedium::printToStream(std::ostream &stream, int level) const
 {
@@ -226,33 +254,56 @@ void LoRaMedium::removeNonInterferingTransmissions()
         delete transmission;
     }
     transmissions.erase(transmissions.begin(), transmissions.begin() + transmissionIndex);
+    // any current interference may refer to the receptions of the removed
+    // transmissions, not only the ones computed for them, so drop them all
+    if (transmissionIndex != 0) {
+        for (auto& entry : currentInterferences)
+            delete entry.second.first;
+        currentInterferences.clear();
+    }
     communicationCache->removeNonInterferingTransmissions();
     if (transmissions.size() > 0)
         scheduleAt(communicationCache->getCachedInterferenceEndTime(transmissions[0]), removeNonInterferingTransmissionsTimer);
 }
 
-const std::vector<const IReception *> *LoRaMedium::computeInterferingReceptions(const IListening *listening, const std::vector<const ITransmission *> *transmissions) const
+std::vector<const IReception *> *LoRaMedium::computeInterferingReceptions(const IListening *listening, const std::vector<const ITransmission *> *transmissions) const
 {
     const IRadio *radio = listening->getReceiver();
-    std::vector<const ITransmission *> *interferingTransmissions = communicationCache->computeInterferingTransmissions(radio, listening->getStartTime(), listening->getEndTime());
-    std::vector<const IReception *> *interferingReceptions = new std::vector<const IReception *>();
-    for (const auto interferingTransmission : *interferingTransmissions)
-        if (isInterferingTransmission(interferingTransmission, listening))
-            interferingReceptions->push_back(getReception(radio, interferingTransmission));
-    delete interferingTransmissions;
+    std::vector<const IReception *> *interferingReceptions = interferingReceptionsPool->acquire();
+    if (loRaCommunicationCache) {
+        loRaCommunicationCache->computeInterferingTransmissions(radio, listening->getStartTime(), listening->getEndTime(), interferingTransmissionsBuffer);
+        for (const auto interferingTransmission : interferingTransmissionsBuffer)
+            if (isInterferingTransmission(interferingTransmission, listening))
+                interferingReceptions->push_back(getReception(radio, interferingTransmission));
+    }
+    else {
+        std::vector<const ITransmission *> *interferingTransmissions = communicationCache->computeInterferingTransmissions(radio, listening->getStartTime(), listening->getEndTime());
+        for (const auto interferingTransmission : *interferingTransmissions)
+            if (isInterferingTransmission(interferingTransmission, listening))
+                interferingReceptions->push_back(getReception(radio, interferingTransmission));
+        delete interferingTransmissions;
+    }
     return interferingReceptions;
 }
 
-const std::vector<const IReception *> *LoRaMedium::computeInterferingReceptions(const IReception *reception, const std::vector<const ITransmission *> *transmissions) const
+std::vector<const IReception *> *LoRaMedium::computeInterferingReceptions(const IReception *reception, const std::vector<const ITransmission *> *transmissions) const
 {
     const IRadio *radio = reception->getReceiver();
     const ITransmission *transmission = reception->getTransmission();
-    std::vector<const ITransmission *> *interferingTransmissions = communicationCache->computeInterferingTransmissions(radio, reception->getStartTime(), reception->getEndTime());
-    std::vector<const IReception *> *interferingReceptions = new std::vector<const IReception *>();
-    for (const auto interferingTransmission : *interferingTransmissions)
-        if (transmission != interferingTransmission && isInterferingTransmission(interferingTransmission, reception))
-            interferingReceptions->push_back(getReception(radio, interferingTransmission));
-    delete interferingTransmissions;
+    std::vector<const IReception *> *interferingReceptions = interferingReceptionsPool->acquire();
+    if (loRaCommunicationCache) {
+        loRaCommunicationCache->computeInterferingTransmissions(radio, reception->getStartTime(), reception->getEndTime(), interferingTransmissionsBuffer);
+        for (const auto interferingTransmission : interferingTransmissionsBuffer)
+            if (transmission != interferingTransmission && isInterferingTransmission(interferingTransmission, reception))
+                interferingReceptions->push_back(getReception(radio, interferingTransmission));
+    }
+    else {
+        std::vector<const ITransmission *> *interferingTransmissions = communicationCache->computeInterferingTransmissions(radio, reception->getStartTime(), reception->getEndTime());
+        for (const auto interferingTransmission : *interferingTransmissions)
+            if (transmission != interferingTransmission && isInterferingTransmission(interferingTransmission, reception))
+                interferingReceptions->push_back(getReception(radio, interferingTransmission));
+        delete interferingTransmissions;
+    }
     return interferingReceptions;
 }
 const IReception *LoRaMedium::computeReception(const IRadio *radio, const ITransmission *transmission) const
@@ -264,16 +315,16 @@ const IInterference *LoRaMedium::computeInterference(const IRadio *receiver, con
 {
     interferenceComputationCount++;
     const INoise *noise = backgroundNoise ? backgroundNoise->computeNoise(listening) : nullptr;
-    const std::vector<const IReception *> *interferingReceptions = computeInterferingReceptions(listening, transmissions);
-    return new Interference(noise, interferingReceptions);
+    std::vector<const IReception *> *interferingReceptions = computeInterferingReceptions(listening, transmissions);
+    return new LoRaInterference(noise, interferingReceptions, interferingReceptionsPool);
 }
 const IInterference *LoRaMedium::computeInterference(const IRadio *receiver, const IListening *listening, const ITransmission *transmission, const std::vector<const ITransmission *> *transmissions) const
 {
     interferenceComputationCount++;
     const IReception *reception = getReception(receiver, transmission);
     const INoise *noise = backgroundNoise ? backgroundNoise->computeNoise(listening) : nullptr;
-    const std::vector<const IReception *> *interferingReceptions = computeInterferingReceptions(reception, transmissions);
-    return new Interference(noise, interferingReceptions);
+    std::vector<const IReception *> *interferingReceptions = computeInterferingReceptions(reception, transmissions);
+    return new LoRaInterference(noise, interferingReceptions, interferingReceptionsPool);
 }
 const IReceptionDecision *LoRaMedium::computeReceptionDecision(const IRadio *radio, const IListening *listening, const ITransmission *transmission, IRadioSignal::SignalPart part, const std::vector<const ITransmission *> *transmissions) const
 {
@@ -331,11 +382,31 @@ const IInterference *LoRaMedium::getInterference(const IRadio *receiver, const I
     if (interference)
         cacheInterferenceHitCount++;
     else {
-        interference = computeInterference(receiver, listening, transmission, const_cast<const std::vector<const ITransmission *> *>(&transmissions));
+        // the communication cache takes over the current interference
+        interference = getCurrentInterference(receiver, listening, transmission);
+        currentInterferences.erase(((int64_t)receiver->getId() << 32) | (uint32_t)transmission->getId());
         communicationCache->setCachedInterference(receiver, transmission, interference);
     }
     return interference;
 }
+const IInterference *LoRaMedium::getCurrentInterference(const IRadio *receiver, const IListening *listening, const ITransmission *transmission) const
+{
+    cacheCurrentInterferenceGetCount++;
+    long arrivalVersion = arrivalVersions[receiver->getId()];
+    int64_t key = ((int64_t)receiver->getId() << 32) | (uint32_t)transmission->getId();
+    auto it = currentInterferences.find(key);
+    if (it != currentInterferences.end()) {
+        if (it->second.second == arrivalVersion) {
+            cacheCurrentInterferenceHitCount++;
+            return it->second.first;
+        }
+        delete it->second.first;
+        currentInterferences.erase(it);
+    }
+    const IInterference *interference = computeInterference(receiver, listening, transmission, const_cast<const std::vector<const ITransmission *> *>(&transmissions));
+    currentInterferences[key] = std::make_pair(interference, arrivalVersion);
+    return interference;
+}
 const INoise *LoRaMedium::getNoise(const IRadio *receiver, const ITransmission *transmission) const
 {
     cacheNoiseGetCount++;
@@ -390,9 +461,60 @@ const IReceptionResult *LoRaMedium::getReceptionResult(const IRadio *radio, cons
     }
     return result;
 }
+
+double LoRaMedium::getMeanPathLoss(const IRadio *transmitter, const IRadio *receiver) const
+{
+    if (!useLinkBudgetTable || mediumLimitCache->getMaxSpeed() != mps(0) || dynamic_cast<const ILoRaPathLoss *>(pathLoss) == nullptr)
+        return NaN;
+    if (linkBudgetTableInvalid)
+        buildLinkBudgetTable();
+    size_t transmitterIndex = transmitter->getId() - linkBudgetTableBaseId;
+    size_t receiverIndex = receiver->getId() - linkBudgetTableBaseId;
+    if (transmitterIndex >= linkBudgetTableSize || receiverIndex >= linkBudgetTableSize)
+        return NaN;
+    double meanPathLoss = linkBudgetTable[transmitterIndex * linkBudgetTableSize + receiverIndex];
+    if (!std::isnan(meanPathLoss))
+        linkBudgetTableHitCount++;
+    return meanPathLoss;
+}
+
+void LoRaMedium::buildLinkBudgetTable() const
+{
+    const ILoRaPathLoss *loRaPathLoss = check_and_cast<const ILoRaPathLoss *>(pathLoss);
+    linkBudgetTableInvalid = false;
+    linkBudgetTableBaseId = radios.empty() ? -1 : radios[0]->getId();
+    linkBudgetTableSize = radios.size();
+    linkBudgetTable.assign(linkBudgetTableSize * linkBudgetTableSize, NaN);
+    for (size_t i = 0; i < linkBudgetTableSize; i++) {
+        if (radios[i] == nullptr)
+            continue;
+        Coord transmitterPosition = radios[i]->getAntenna()->getMobility()->getCurrentPosition();
+        for (size_t j = 0; j < i; j++) {
+            // directional antenna gains depend on the orientations, so these
+            // pairs keep computing the reception power in full
+            if (radios[j] == nullptr || !isIsotropicAntenna(radios[i]) || !isIsotropicAntenna(radios[j]))
+                continue;
+            Coord receiverPosition = radios[j]->getAntenna()->getMobility()->getCurrentPosition();
+            // isotropic antennas have a gain of 1, which is what the analog
+            // model multiplied the path loss by before
+            double meanPathLoss = loRaPathLoss->computeMeanPathLoss(m(transmitterPosition.distance(receiverPosition)));
+            linkBudgetTable[i * linkBudgetTableSize + j] = meanPathLoss;
+            linkBudgetTable[j * linkBudgetTableSize + i] = meanPathLoss;
+        }
+    }
+    EV_DEBUG << "Computed link budget table for " << linkBudgetTableSize << " radios" << endl;
+}
+
+bool LoRaMedium::isIsotropicAntenna(const IRadio *radio) const
+{
+    return dynamic_cast<const IsotropicAntenna *>(radio->getAntenna()) != nullptr;
+}
+
 void LoRaMedium::addRadio(const IRadio *radio)
 {
     radios.push_back(radio);
+    spatialIndexInvalid = true;
+    linkBudgetTableInvalid = true;
     communicationCache->addRadio(radio);
     if (neighborCache)
         neighborCache->addRadio(radio);
@@ -422,6 +544,8 @@ void LoRaMedium::removeRadio(const IRadio *radio)
         radioCount++;
     if (radioCount != 0)
         radios.erase(radios.begin(), radios.begin() + radioCount);
+    spatialIndexInvalid = true;
+    linkBudgetTableInvalid = true;
     communicationCache->removeRadio(radio);
     if (neighborCache)
         neighborCache->removeRadio(radio);
@@ -442,17 +566,30 @@ void LoRaMedium::addTransmission(const IRadio *transmitterRadio, const ITransmis
     transmissions.push_back(transmission);
     communicationCache->addTransmission(transmission);
     simtime_t maxArrivalEndTime = transmission->getEndTime();
-    for (const auto receiverRadio : radios) {
-        if (receiverRadio != nullptr && receiverRadio != transmitterRadio) {
-            const IArrival *arrival = propagation->computeArrival(transmission, receiverRadio->getAntenna()->getMobility());
-            const Interval *interval = new Interval(arrival->getStartTime(), arrival->getEndTime(), (void *)transmission);
-            const IListening *listening = receiverRadio->getReceiver()->createListening(receiverRadio, arrival->getStartTime(), arrival->getEndTime(), arrival->getStartPosition(), arrival->getEndPosition());
-            const simtime_t arrivalEndTime = arrival->getEndTime();
-            if (arrivalEndTime > maxArrivalEndTime)
-                maxArrivalEndTime = arrivalEndTime;
-            communicationCache->setCachedArrival(receiverRadio, transmission, arrival);
-            communicationCache->setCachedInterval(receiverRadio, transmission, interval);
-            communicationCache->setCachedListening(receiverRadio, transmission, listening);
+    if (isSpatialIndexUsable()) {
+        // radios outside the maximum interference range get no cached arrival,
+        // the communication cache then never reports them as interfering
+        computeSpatialIndexCandidates(transmission, spatialIndexCandidates);
+        for (const auto receiverRadio : spatialIndexCandidates) {
+            if (receiverRadio != transmitterRadio) {
+                const simtime_t arrivalEndTime = addArrival(receiverRadio, transmission);
+                if (arrivalEndTime > maxArrivalEndTime)
+                    maxArrivalEndTime = arrivalEndTime;
+            }
+        }
+        spatialIndexSkipCount += radios.size() - spatialIndexCandidates.size();
+    }
+    else {
+        if (useSpatialIndex && !spatialIndexUnusableWarned) {
+            EV_WARN << "Spatial index requested but the maximum interference range is unknown, computing arrivals for all radios" << endl;
+            spatialIndexUnusableWarned = true;
+        }
+        for (const auto receiverRadio : radios) {
+            if (receiverRadio != nullptr && receiverRadio != transmitterRadio) {
+                const simtime_t arrivalEndTime = addArrival(receiverRadio, transmission);
+                if (arrivalEndTime > maxArrivalEndTime)
+                    maxArrivalEndTime = arrivalEndTime;
+            }
         }
     }
     communicationCache->setCachedInterferenceEndTime(transmission, maxArrivalEndTime + mediumLimitCache->getMaxTransmissionDuration());
@@ -463,6 +600,81 @@ void LoRaMedium::addTransmission(const IRadio *transmitterRadio, const ITransmis
     emit(transmissionAddedSignal, check_and_cast<const cObject *>(transmission));
 }
 
+simtime_t LoRaMedium::addArrival(const IRadio *receiverRadio, const ITransmission *transmission)
+{
+    const IArrival *arrival = propagation->computeArrival(transmission, receiverRadio->getAntenna()->getMobility());
+    const IListening *listening = receiverRadio->getReceiver()->createListening(receiverRadio, arrival->getStartTime(), arrival->getEndTime(), arrival->getStartPosition(), arrival->getEndPosition());
+    communicationCache->setCachedArrival(receiverRadio, transmission, arrival);
+    if (loRaCommunicationCache)
+        loRaCommunicationCache->addArrivalInterval(receiverRadio, transmission, arrival->getStartTime(), arrival->getEndTime());
+    else {
+        const Interval *interval = new Interval(arrival->getStartTime(), arrival->getEndTime(), (void *)transmission);
+        communicationCache->setCachedInterval(receiverRadio, transmission, interval);
+    }
+    communicationCache->setCachedListening(receiverRadio, transmission, listening);
+    arrivalVersions[receiverRadio->getId()]++;
+    return arrival->getEndTime();
+}
+
+static inline int64_t getSpatialIndexCellKey(int x, int y)
+{
+    return ((int64_t)x << 32) | (uint32_t)y;
+}
+
+bool LoRaMedium::isSpatialIndexUsable() const
+{
+    if (!useSpatialIndex)
+        return false;
+    double maxInterferenceRange = mediumLimitCache->getMaxInterferenceRange().get();
+    double maxSpeed = mediumLimitCache->getMaxSpeed().get();
+    return std::isfinite(maxInterferenceRange) && maxInterferenceRange > 0 && std::isfinite(maxSpeed);
+}
+
+void LoRaMedium::buildSpatialIndex()
+{
+    spatialIndexCells.clear();
+    spatialIndexCellSize = mediumLimitCache->getMaxInterferenceRange().get();
+    spatialIndexBuildTime = simTime();
+    spatialIndexInvalid = false;
+    for (const auto radio : radios) {
+        if (radio != nullptr) {
+            Coord position = radio->getAntenna()->getMobility()->getCurrentPosition();
+            int x = (int)std::floor(position.x / spatialIndexCellSize);
+            int y = (int)std::floor(position.y / spatialIndexCellSize);
+            spatialIndexCells[getSpatialIndexCellKey(x, y)].push_back(radio);
+        }
+    }
+    EV_DEBUG << "Built spatial index with " << spatialIndexCells.size() << " cells of " << spatialIndexCellSize << " m" << endl;
+}
+
+void LoRaMedium::computeSpatialIndexCandidates(const ITransmission *transmission, std::vector<const IRadio *>& candidates)
+{
+    candidates.clear();
+    // both ends may move while the transmission and its arrivals last
+    double maxSpeed = mediumLimitCache->getMaxSpeed().get();
+    double maxTransmissionDuration = mediumLimitCache->getMaxTransmissionDuration().dbl();
+    double margin = 2 * maxSpeed * ((simTime() - spatialIndexBuildTime).dbl() + maxTransmissionDuration);
+    if (spatialIndexInvalid || spatialIndexCellSize != mediumLimitCache->getMaxInterferenceRange().get() || margin > spatialIndexCellSize) {
+        buildSpatialIndex();
+        margin = 2 * maxSpeed * maxTransmissionDuration;
+    }
+    double range = spatialIndexCellSize + margin;
+    const Coord& position = transmission->getStartPosition();
+    int minX = (int)std::floor((position.x - range) / spatialIndexCellSize);
+    int maxX = (int)std::floor((position.x + range) / spatialIndexCellSize);
+    int minY = (int)std::floor((position.y - range) / spatialIndexCellSize);
+    int maxY = (int)std::floor((position.y + range) / spatialIndexCellSize);
+    for (int x = minX; x <= maxX; x++) {
+        for (int y = minY; y <= maxY; y++) {
+            auto it = spatialIndexCells.find(getSpatialIndexCellKey(x, y));
+            if (it != spatialIndexCells.end())
+                for (const auto radio : it->second)
+                    if (position.distance(radio->getAntenna()->getMobility()->getCurrentPosition()) < range)
+                        candidates.push_back(radio);
+        }
+    }
+}
+
 IRadioFrame *LoRaMedium::createTransmitterRadioFrame(const IRadio *radio, cPacket *macFrame)
 {
     Enter_Method_Silent();
@@ -478,14 +690,11 @@ IRadioFrame *LoRaMedium::createTransmitterRadioFrame(const IRadio *radio, cPacke
 }
 IRadioFrame *LoRaMedium::createReceiverRadioFrame(const ITransmission *transmission)
 {
-    auto radioFrame = new RadioFrame(transmission);
-    auto phyFrame = const_cast<cPacket *>(transmission->getPhyFrame());
-    auto macFrame = const_cast<cPacket *>(transmission->getMacFrame());
-    auto encapsulatedFrame = phyFrame != nullptr ? phyFrame : macFrame;
-    radioFrame->setName(encapsulatedFrame->getName());
-    radioFrame->setDuration(transmission->getDuration());
-    radioFrame->encapsulate(encapsulatedFrame->dup());
-    return radioFrame;
+    // the copy shares the reference counted encapsulated frame with the
+    // transmitter's radio frame, receivers only get their own copy of the
+    // MAC frame when they successfully receive it in receivePacket
+    auto transmitterRadioFrame = check_and_cast<const RadioFrame *>(communicationCache->getCachedFrame(transmission));
+    return transmitterRadioFrame->dup();
 }
 void LoRaMedium::sendToAffectedRadios(IRadio *radio, const IRadioFrame *frame)
 {
@@ -517,7 +726,8 @@ void LoRaMedium::sendToRadio(IRadio *transmitter, const IRadio *receiver, const
     const Radio *transmitterRadio = check_and_cast<const Radio *>(transmitter);
     const Radio *receiverRadio = check_and_cast<const Radio *>(receiver);
     const ITransmission *transmission = frame->getTransmission();
-    if (receiverRadio != transmitterRadio && isPotentialReceiver(receiverRadio, transmission)) {
+    // radios without a cached arrival are outside the interference range
+    if (receiverRadio != transmitterRadio && getArrival(receiverRadio, transmission) != nullptr && isPotentialReceiver(receiverRadio, transmission)) {
         const IArrival *arrival = getArrival(receiverRadio, transmission);
         simtime_t propagationTime = arrival->getStartPropagationTime();
         EV_DEBUG << "Sending " << frame
@@ -539,8 +749,8 @@ IRadioFrame *LoRaMedium::transmitPacket(const IRadio *radio, cPacket *macFrame)
     addTransmission(radio, transmission);
     if (recordCommunicationLog)
         communicationLog.writeTransmission(radio, radioFrame);
-    sendToAffectedRadios(const_cast<IRadio *>(radio), radioFrame);
     communicationCache->setCachedFrame(transmission, radioFrame);
+    sendToAffectedRadios(const_cast<IRadio *>(radio), radioFrame);
     return radioFrame;
 }
 cPacket *LoRaMedium::receivePacket(const IRadio *radio, IRadioFrame *radioFrame)
@@ -556,6 +766,11 @@ cPacket *LoRaMedium::receivePacket(const IRadio *radio, IRadioFrame *radioFrame)
     delete result;
     return macFrame;
 }
+void LoRaMedium::dropPacket(const IRadio *radio, IRadioFrame *radioFrame)
+{
+    if (recordCommunicationLog)
+        communicationLog.writeReception(radio, radioFrame);
+}
 const IListeningDecision *LoRaMedium::listenOnMedium(const IRadio *radio, const IListening *listening) const
 {
     const IListeningDecision *decision = computeListeningDecision(radio, listening, const_cast<const std::vector<const ITransmission *> *>(&transmissions));
@@ -586,31 +801,28 @@ bool LoRaMedium::isReceptionPossible(const IRadio *receiver, const ITransmission
 {
     const IReception *reception = getReception(receiver, transmission);
     const IListening *listening = getListening(receiver, transmission);
-    // TODO: why compute?
-    const IInterference *interference = computeInterference(receiver, listening, transmission, const_cast<const std::vector<const ITransmission *> *>(&transmissions));
+    // computed with all arrivals so far, unlike the frozen interference of getInterference
+    const IInterference *interference = getCurrentInterference(receiver, listening, transmission);
     bool isReceptionPossible = receiver->getReceiver()->computeIsReceptionAttempted(listening, reception, part, interference);
-    delete interference;
     return isReceptionPossible;
 }
 bool LoRaMedium::isReceptionAttempted(const IRadio *receiver, const ITransmission *transmission, IRadioSignal::SignalPart part) const
 {
     const IReception *reception = getReception(receiver, transmission);
     const IListening *listening = getListening(receiver, transmission);
-    // TODO: why compute?
-    const IInterference *interference = computeInterference(receiver, listening, transmission, const_cast<const std::vector<const ITransmission *> *>(&transmissions));
+    // computed with all arrivals so far, unlike the frozen interference of getInterference
+    const IInterference *interference = getCurrentInterference(receiver, listening, transmission);
     bool isReceptionAttempted = receiver->getReceiver()->computeIsReceptionAttempted(listening, reception, part, interference);
-    delete interference;
     return isReceptionAttempted;
 }
 bool LoRaMedium::isReceptionSuccessful(const IRadio *receiver, const ITransmission *transmission, IRadioSignal::SignalPart part) const
 {
     const IReception *reception = getReception(receiver, transmission);
     const IListening *listening = getListening(receiver, transmission);
-    // TODO: why compute?
-    const IInterference *interference = computeInterference(receiver, listening, transmission, const_cast<const std::vector<const ITransmission *> *>(&transmissions));
+    // computed with all arrivals so far, unlike the frozen interference of getInterference
+    const IInterference *interference = getCurrentInterference(receiver, listening, transmission);
     const ISNIR *snir = getSNIR(receiver, transmission);
     bool isReceptionSuccessful = receiver->getReceiver()->computeIsReceptionSuccessful(listening, reception, part, interference, snir);
-    delete interference;
     return isReceptionSuccessful;
 }
 void LoRaMedium::sendToAllRadios(IRadio *transmitter, const IRadioFrame *frame)
@@ -623,8 +835,12 @@ void LoRaMedium::receiveSignal(cComponent *source, simsignal_t signal, long valu
 {
     if (signal == IRadio::radioModeChangedSignal || signal == IRadio::listeningChangedSignal || signal == NF_INTERFACE_CONFIG_CHANGED) {
         const Radio *receiverRadio = check_and_cast<const Radio *>(source);
+        if (signal == IRadio::listeningChangedSignal)
+            arrivalVersions[receiverRadio->getId()]++;
         for (const auto transmission : transmissions) {
             const Radio *transmitterRadio = check_and_cast<const Radio *>(transmission->getTransmitter());
+            if (getArrival(receiverRadio, transmission) == nullptr)
+                continue;
             if (signal == IRadio::listeningChangedSignal) {
                 const IArrival *arrival = getArrival(receiverRadio, transmission);
                 const IListening *listening = receiverRadio->getReceiver()->createListening(receiverRadio, arrival->getStartTime(), arrival->getEndTime(), arrival->getStartPosition(), arrival->getEndPosition());
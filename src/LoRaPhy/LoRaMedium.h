@@ -16,6 +16,8 @@
 #define LORAPHY_LORAMEDIUM_H_
 #include "inet/physicallayer/common/packetlevel/RadioMedium.h"
 #include "LoRa/LoRaRadio.h"
+#include "LoRaPhy/LoRaCommunicationCache.h"
+#include "LoRaPhy/LoRaInterference.h"
 #include "inet/common/IntervalTree.h"
 #include "inet/environment/contract/IMaterialRegistry.h"
 #include "inet/environment/contract/IPhysicalEnvironment.h"
@@ -27,6 +29,7 @@
 #include "inet/physicallayer/contract/packetlevel/INeighborCache.h"
 #include "inet/physicallayer/contract/packetlevel/IRadioMedium.h"
 #include <algorithm>
+#include <unordered_map>
 namespace inet {
 namespace physicallayer {
 class INET_API LoRaMedium : public cSimpleModule, public cListener, public IRadioMedium
@@ -98,6 +101,20 @@ class INET_API LoRaMedium : public cSimpleModule, public cListener, public IRadi
        * ${resultdir}/${configname}-${runnumber}.tlog
        */
       bool recordCommunicationLog;
+      /**
+       * True means the radio medium keeps a uniform grid of radio positions
+       * and only computes arrivals for the radios that are within the maximum
+       * interference range of a new transmission. Other radios are considered
+       * non-interfering without caching anything for them.
+       */
+      bool useSpatialIndex;
+      /**
+       * True means the mean path loss between every pair of radios is computed
+       * once and looked up for each reception, only the shadowing is drawn per
+       * transmission. Only used if no radio moves and the path loss model
+       * implements ILoRaPathLoss.
+       */
+      bool useLinkBudgetTable;
       //@}
       /** @name Timer */
       //@{
@@ -126,6 +143,57 @@ class INET_API LoRaMedium : public cSimpleModule, public cListener, public IRadi
        */
       //std::vector<IMediumListener *> listeners;
       //@}
+      /** @name Spatial index */
+      //@{
+      /**
+       * The uniform grid of radios keyed by the packed (x, y) cell index. The
+       * cell size is the maximum interference range, so a transmission only
+       * affects radios in the neighboring cells.
+       */
+      std::unordered_map<int64_t, std::vector<const IRadio *>> spatialIndexCells;
+      /**
+       * The side length of the grid cells, or NaN if the grid is not built.
+       */
+      double spatialIndexCellSize;
+      /**
+       * The simulation time when the grid was built from the radio positions.
+       */
+      simtime_t spatialIndexBuildTime;
+      /**
+       * True if the grid must be rebuilt before the next query, because radios
+       * were added or removed since it was built.
+       */
+      bool spatialIndexInvalid;
+      /**
+       * True once the fall back to all radios, when the spatial index is
+       * requested but unusable, has been logged.
+       */
+      bool spatialIndexUnusableWarned;
+      /**
+       * Reusable buffer for the radios returned by a grid query.
+       */
+      std::vector<const IRadio *> spatialIndexCandidates;
+      //@}
+      /** @name Link budget table */
+      //@{
+      /**
+       * The mean path loss from the transmitter to the receiver, including
+       * both antenna gains, stored at row transmitter index, column receiver
+       * index. The index of a radio is its id relative to the id of the first
+       * radio, as in the radio list. Pairs with a directional antenna are NaN.
+       */
+      mutable std::vector<double> linkBudgetTable;
+      /**
+       * The id of the radio with index 0 and the number of rows in the table.
+       */
+      mutable int linkBudgetTableBaseId;
+      mutable size_t linkBudgetTableSize;
+      /**
+       * True if the table must be recomputed before the next lookup, because
+       * radios were added or removed since it was computed.
+       */
+      mutable bool linkBudgetTableInvalid;
+      //@}
       /** @name Cache */
       //@{
       /**
@@ -140,6 +208,32 @@ class INET_API LoRaMedium : public cSimpleModule, public cListener, public IRadi
        * Caches intermediate results of the ongoing communication for all radios.
        */
       mutable ICommunicationCache *communicationCache;
+      /**
+       * The communication cache if it's a LoRaCommunicationCache, which can
+       * be queried without allocation, or nullptr otherwise.
+       */
+      mutable LoRaCommunicationCache *loRaCommunicationCache;
+      /**
+       * Reusable buffer for the interfering transmissions of a query.
+       */
+      mutable std::vector<const ITransmission *> interferingTransmissionsBuffer;
+      /**
+       * Spare vectors for the interfering receptions of the interferences,
+       * which get them back when deleted.
+       */
+      std::shared_ptr<LoRaInterferingReceptionsPool> interferingReceptionsPool;
+      /**
+       * The interference of the ongoing receptions keyed by the packed
+       * (receiver id, transmission id) pair. An entry is only valid as long as
+       * the arrival version of the receiver is the one it was computed with,
+       * and all entries are dropped whenever a transmission is removed.
+       */
+      mutable std::unordered_map<int64_t, std::pair<const IInterference *, long>> currentInterferences;
+      /**
+       * Incremented for a receiver whenever a new arrival or a listening
+       * change may change the interference of its ongoing receptions.
+       */
+      mutable std::unordered_map<int, long> arrivalVersions;
       //@}
       /** @name Logging */
       //@{
@@ -226,6 +320,22 @@ class INET_API LoRaMedium : public cSimpleModule, public cListener, public IRadi
        * Total number of reception result cache hits.
        */
       mutable long cacheResultHitCount;
+      /**
+       * Total number of arrival computations skipped by the spatial index.
+       */
+      mutable long spatialIndexSkipCount;
+      /**
+       * Total number of path loss computations replaced by a table lookup.
+       */
+      mutable long linkBudgetTableHitCount;
+      /**
+       * Total number of current interference queries.
+       */
+      mutable long cacheCurrentInterferenceGetCount;
+      /**
+       * Total number of current interference hits.
+       */
+      mutable long cacheCurrentInterferenceHitCount;
       //@}
     protected:
       /** @name Module */
@@ -241,12 +351,18 @@ class INET_API LoRaMedium : public cSimpleModule, public cListener, public IRadi
        * Adds a new transmission to the radio medium.
        */
       virtual void addTransmission(const IRadio *transmitter, const ITransmission *transmission);
+      /**
+       * Computes and caches the arrival, the interval and the listening of
+       * the transmission for the receiver, and returns the arrival end time.
+       */
+      virtual simtime_t addArrival(const IRadio *receiver, const ITransmission *transmission);
       /**
        * Creates a new radio frame for the transmitter.
        */
       virtual IRadioFrame *createTransmitterRadioFrame(const IRadio *radio, cPacket *macFrame);
       /**
-       * Creates a new radio frame for a receiver.
+       * Creates a new radio frame for a receiver, sharing the encapsulated
+       * frame of the transmitter's radio frame.
        */
       virtual IRadioFrame *createReceiverRadioFrame(const ITransmission *transmission);
       /**
@@ -259,6 +375,34 @@ class INET_API LoRaMedium : public cSimpleModule, public cListener, public IRadi
        */
       virtual void sendToAllRadios(IRadio *transmitter, const IRadioFrame *frame);
       //@}
+      /** @name Spatial index */
+      //@{
+      /**
+       * Returns true if the grid can be used to find the affected radios, that
+       * is the maximum interference range and the maximum speed are known.
+       */
+      virtual bool isSpatialIndexUsable() const;
+      /**
+       * Rebuilds the grid from the current radio positions.
+       */
+      virtual void buildSpatialIndex();
+      /**
+       * Fills the candidates with all radios that may be within the maximum
+       * interference range of the transmission during its whole duration.
+       */
+      virtual void computeSpatialIndexCandidates(const ITransmission *transmission, std::vector<const IRadio *>& candidates);
+      //@}
+      /** @name Link budget table */
+      //@{
+      /**
+       * Recomputes the mean path loss between all pairs of radios.
+       */
+      virtual void buildLinkBudgetTable() const;
+      /**
+       * Returns true if the gain of the antenna doesn't depend on the direction.
+       */
+      virtual bool isIsotropicAntenna(const IRadio *radio) const;
+      //@}
       /** @name Reception */
       //@{
       virtual bool isRadioMacAddress(const IRadio *radio, const MACAddress address) const;
@@ -279,8 +423,8 @@ class INET_API LoRaMedium : public cSimpleModule, public cListener, public IRadi
        * interference for another.
        */
       virtual void removeNonInterferingTransmissions();
-      virtual const std::vector<const IReception *> *computeInterferingReceptions(const IListening *listening, const std::vector<const ITransmission *> *transmissions) const;
-      virtual const std::vector<const IReception *> *computeInterferingReceptions(const IReception *reception, const std::vector<const ITransmission *> *transmissions) const;
+      virtual std::vector<const IReception *> *computeInterferingReceptions(const IListening *listening, const std::vector<const ITransmission *> *transmissions) const;
+      virtual std::vector<const IReception *> *computeInterferingReceptions(const IReception *reception, const std::vector<const ITransmission *> *transmissions) const;
       virtual const IReception *computeReception(const IRadio *receiver, const ITransmission *transmission) const;
       virtual const IInterference *computeInterference(const IRadio *receiver, const IListening *listening, const std::vector<const ITransmission *> *transmissions) const;
       virtual const IInterference *computeInterference(const IRadio *receiver, const IListening *listening, const ITransmission *transmission, const std::vector<const ITransmission *> *transmissions) const;
@@ -320,12 +464,29 @@ class INET_API LoRaMedium : public cSimpleModule, public cListener, public IRadi
       virtual void sendToRadio(IRadio *trasmitter, const IRadio *receiver, const IRadioFrame *frame);
       virtual IRadioFrame *transmitPacket(const IRadio *transmitter, cPacket *macFrame) override;
       virtual cPacket *receivePacket(const IRadio *receiver, IRadioFrame *radioFrame) override;
+      /**
+       * Records a failed reception in the communication log without copying
+       * the MAC frame, as receivePacket would.
+       */
+      virtual void dropPacket(const IRadio *receiver, IRadioFrame *radioFrame);
       virtual const IListeningDecision *listenOnMedium(const IRadio *receiver, const IListening *listening) const override;
       virtual const IArrival *getArrival(const IRadio *receiver, const ITransmission *transmission) const override;
       virtual const IListening *getListening(const IRadio *receiver, const ITransmission *transmission) const override;
       virtual const IReception *getReception(const IRadio *receiver, const ITransmission *transmission) const override;
       virtual const IInterference *getInterference(const IRadio *receiver, const ITransmission *transmission) const override;
       virtual const IInterference *getInterference(const IRadio *receiver, const IListening *listening, const ITransmission *transmission) const;
+      /**
+       * Returns the interference of the transmission at the receiver taking
+       * into account all arrivals so far. The result is memoized until a new
+       * arrival reaches the receiver, and it's owned by the radio medium.
+       */
+      virtual const IInterference *getCurrentInterference(const IRadio *receiver, const IListening *listening, const ITransmission *transmission) const;
+      /**
+       * Returns the mean path loss times both antenna gains from the link
+       * budget table, or NaN if the table is not used for this pair. Only
+       * the shadowing remains to be drawn per reception.
+       */
+      virtual double getMeanPathLoss(const IRadio *transmitter, const IRadio *receiver) const;
       virtual const INoise *getNoise(const IRadio *receiver, const ITransmission *transmission) const override;
       virtual const ISNIR *getSNIR(const IRadio *receiver, const ITransmission *transmission) const override;
       virtual bool isReceptionPossible(const IRadio *receiver, const ITransmission *transmission, IRadioSignal::SignalPart part) const override;
@@ -19,6 +19,8 @@
 #include "LoRaPhy/LoRaMediumCache.h"
 #include "LoRaPhy/LoRaMedium.h"
 #include "LoRaPhy/LoRaLogNormalShadowing.h"
+#include "LoRaPhy/LoRaPhyTables.h"
+#include "LoRaPhy/ILoRaPathLoss.h"
 
 namespace inet {
 
@@ -203,7 +205,29 @@ m LoRaMediumCache::computeMaxRange(W maxTransmissionPower, W minReceptionPower)
 
 m LoRaMediumCache::computeMaxInterferenceRange() const
 {
-    return maxIgnoreNaN(m(par("maxInterferenceRange")), computeMaxRange(maxTransmissionPower, minInterferencePower));
+    m maxInterferenceRange = maxIgnoreNaN(m(par("maxInterferenceRange")), computeMaxRange(maxTransmissionPower, minInterferencePower));
+    if (std::isnan(maxInterferenceRange.get()))
+        maxInterferenceRange = computeLoRaInterferenceRange();
+    return maxInterferenceRange;
+}
+
+m LoRaMediumCache::computeLoRaInterferenceRange() const
+{
+    // carrierFrequency and minInterferencePower are NaN by default, so the
+    // generic computation above gives no range. Signals far enough below the
+    // best receiver sensitivity can't make a decodable reception collide, and
+    // k sigma of margin covers all but the most favourable shadowing draws
+    const ILoRaPathLoss *loRaPathLoss = dynamic_cast<const ILoRaPathLoss *>(radioMedium->getPathLoss());
+    if (loRaPathLoss == nullptr || std::isnan(maxTransmissionPower.get()))
+        return m(NaN);
+    double minSensitivity = LoRaPhyTables::DEFAULT_SENSITIVITY_DBM;
+    for (int i = 0; i < LoRaPhyTables::NUM_SPREADING_FACTORS; i++)
+        for (int j = 0; j < LoRaPhyTables::NUM_BANDWIDTHS; j++)
+            minSensitivity = std::min(minSensitivity, LoRaPhyTables::SENSITIVITY_DBM[i][j]);
+    double margin = par("interferenceRangeMargin").doubleValue() + par("interferenceRangeShadowingFactor").doubleValue() * loRaPathLoss->getShadowingSigma();
+    W interferenceFloor = mW(math::dBm2mW(minSensitivity - margin));
+    double antennaGain = std::isnan(maxAntennaGain) ? 1 : maxAntennaGain;
+    return loRaPathLoss->computeRange(maxTransmissionPower * antennaGain * antennaGain, interferenceFloor);
 }
 
 const simtime_t LoRaMediumCache::computeMinInterferenceTime() const
@@ -121,6 +121,7 @@ class INET_API LoRaMediumCache : public cModule, public IMediumLimitCache
 
     virtual m computeMaxRange(W maxTransmissionPower, W minReceptionPower) const;
     virtual m computeMaxInterferenceRange() const;
+    virtual m computeLoRaInterferenceRange() const;
 
     virtual void updateLimits();
     //@}
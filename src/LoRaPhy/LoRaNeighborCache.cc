@@ -16,6 +16,9 @@
 //
 
 #include "LoRaPhy/LoRaNeighborCache.h"
+#include "LoRaPhy/LoRaReceiver.h"
+#include "LoRaPhy/LoRaTransmission.h"
+#include "LoRaPhy/ILoRaPathLoss.h"
 #include "inet/common/ModuleAccess.h"
 
 namespace inet {
@@ -29,8 +32,16 @@ LoRaNeighborCache::LoRaNeighborCache() :
     updateNeighborListsTimer(nullptr),
     refillPeriod(NaN),
     range(NaN),
-    maxSpeed(NaN)
+    maxSpeed(NaN),
+    cellSize(NaN),
+    neighborListsBuilt(false),
+    splitBySpreadingFactor(false),
+    maxTransmissionPower(W(NaN)),
+    shadowingMargin(NaN)
 {
+    for (int i = 0; i < NUM_SPREADING_FACTORS; i++)
+        for (int j = 0; j < NUM_BANDWIDTHS; j++)
+            sensitivityRanges[i][j] = NaN;
 }
 
 void LoRaNeighborCache::initialize(int stage)
@@ -39,6 +50,9 @@ void LoRaNeighborCache::initialize(int stage)
         radioMedium = getModuleFromPar<LoRaMedium>(par("radioMediumModule"), this);
         refillPeriod = par("refillPeriod");
         range = par("range");
+        splitBySpreadingFactor = par("splitBySpreadingFactor");
+        maxTransmissionPower = W(math::dBm2mW(par("maxTransmissionPower")) / 1000);
+        shadowingMargin = par("shadowingMargin");
         updateNeighborListsTimer = new cMessage("updateNeighborListsTimer");
     }
     else if (stage == INITSTAGE_LINK_LAYER_2) {
@@ -71,9 +85,20 @@ void LoRaNeighborCache::sendToNeighbors(IRadio *transmitter, const IRadioFrame *
 
     RadioEntry *radioEntry = it->second;
     Radios& neighborVector = radioEntry->neighborVector;
+    size_t neighborCount = neighborVector.size();
 
-    for (auto & elem : neighborVector)
-        radioMedium->sendToRadio(transmitter, elem, frame);
+    // neighbors are sorted by distance, so the ones that can receive the
+    // frame's spreading factor and bandwidth come first
+    const LoRaTransmission *loRaTransmission = dynamic_cast<const LoRaTransmission *>(frame->getTransmission());
+    if (splitBySpreadingFactor && loRaTransmission != nullptr) {
+        int sfIndex = loRaTransmission->getLoRaSF() - MIN_SPREADING_FACTOR;
+        int bwIndex = getBandwidthIndex(loRaTransmission->getLoRaBW());
+        if (sfIndex >= 0 && sfIndex < NUM_SPREADING_FACTORS && bwIndex >= 0)
+            neighborCount = radioEntry->neighborCounts[sfIndex][bwIndex];
+    }
+
+    for (size_t i = 0; i < neighborCount; i++)
+        radioMedium->sendToRadio(transmitter, neighborVector[i], frame);
 }
 
 void LoRaNeighborCache::handleMessage(cMessage *msg)
@@ -86,22 +111,143 @@ void LoRaNeighborCache::handleMessage(cMessage *msg)
     scheduleAt(simTime() + refillPeriod, msg);
 }
 
+double LoRaNeighborCache::getNeighborRadius() const
+{
+    return maxSpeed * refillPeriod + range;
+}
+
+int LoRaNeighborCache::getBandwidthIndex(Hz loRaBW)
+{
+    return LoRaPhyTables::getBandwidthIndex(loRaBW);
+}
+
+m LoRaNeighborCache::computeSensitivityRange(W transmissionPower, W sensitivity) const
+{
+    const ILoRaPathLoss *loRaPathLoss = dynamic_cast<const ILoRaPathLoss *>(radioMedium->getPathLoss());
+    if (loRaPathLoss != nullptr)
+        return loRaPathLoss->computeRange(transmissionPower, sensitivity);
+    else
+        return m(NaN);
+}
+
+bool LoRaNeighborCache::updateSensitivityRanges()
+{
+    W mediumTransmissionPower = radioMedium->getMediumLimitCache()->getMaxTransmissionPower();
+    W transmissionPower = std::isnan(mediumTransmissionPower.get()) || mediumTransmissionPower < maxTransmissionPower ? maxTransmissionPower : mediumTransmissionPower;
+    double antennaGain = radioMedium->getMediumLimitCache()->getMaxAntennaGain();
+    if (!std::isnan(antennaGain))
+        transmissionPower = transmissionPower * antennaGain * antennaGain;
+    bool changed = false;
+    for (int i = 0; i < NUM_SPREADING_FACTORS; i++) {
+        for (int j = 0; j < NUM_BANDWIDTHS; j++) {
+            W sensitivity = LoRaReceiver::getSensitivity(MIN_SPREADING_FACTOR + i, Hz(LoRaPhyTables::BANDWIDTHS[j]));
+            double sensitivityRange = computeSensitivityRange(transmissionPower * math::dB2fraction(shadowingMargin), sensitivity).get();
+            // unknown path loss models can't be inverted, use the whole cache range
+            if (std::isnan(sensitivityRange) || sensitivityRange > range)
+                sensitivityRange = range;
+            if (sensitivityRange != sensitivityRanges[i][j]) {
+                sensitivityRanges[i][j] = sensitivityRange;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+void LoRaNeighborCache::updateNeighborCounts(RadioEntry *radioEntry)
+{
+    const std::vector<double>& distances = radioEntry->neighborDistances;
+    for (int i = 0; i < NUM_SPREADING_FACTORS; i++) {
+        for (int j = 0; j < NUM_BANDWIDTHS; j++) {
+            double radius = maxSpeed * refillPeriod + sensitivityRanges[i][j];
+            radioEntry->neighborCounts[i][j] = std::upper_bound(distances.begin(), distances.end(), radius) - distances.begin();
+        }
+    }
+}
+
+void LoRaNeighborCache::insertNeighbor(RadioEntry *radioEntry, const IRadio *neighbor, double distance)
+{
+    // keep the (distance, id) order used by updateNeighborList
+    std::vector<double>& distances = radioEntry->neighborDistances;
+    size_t index = std::lower_bound(distances.begin(), distances.end(), distance) - distances.begin();
+    while (index < distances.size() && distances[index] == distance && radioEntry->neighborVector[index]->getId() < neighbor->getId())
+        index++;
+    distances.insert(distances.begin() + index, distance);
+    radioEntry->neighborVector.insert(radioEntry->neighborVector.begin() + index, neighbor);
+    updateNeighborCounts(radioEntry);
+}
+
+int64_t LoRaNeighborCache::getCell(const Coord& position) const
+{
+    // without a usable cell size all radios share a single cell
+    if (!std::isfinite(cellSize) || cellSize <= 0)
+        return 0;
+    int32_t x = (int32_t)std::floor(position.x / cellSize);
+    int32_t y = (int32_t)std::floor(position.y / cellSize);
+    return ((int64_t)x << 32) | (uint32_t)y;
+}
+
+void LoRaNeighborCache::addToGrid(RadioEntry *radioEntry)
+{
+    radioEntry->cell = getCell(radioEntry->radio->getAntenna()->getMobility()->getCurrentPosition());
+    grid[radioEntry->cell].push_back(radioEntry);
+}
+
+void LoRaNeighborCache::removeFromGrid(RadioEntry *radioEntry)
+{
+    auto it = grid.find(radioEntry->cell);
+    if (it != grid.end()) {
+        RadioEntries& cellEntries = it->second;
+        cellEntries.erase(std::remove(cellEntries.begin(), cellEntries.end(), radioEntry), cellEntries.end());
+        if (cellEntries.empty())
+            grid.erase(it);
+    }
+}
+
 void LoRaNeighborCache::updateNeighborList(RadioEntry *radioEntry)
 {
     IMobility *radioMobility = radioEntry->radio->getAntenna()->getMobility();
     Coord radioPosition = radioMobility->getCurrentPosition();
-    double radius = maxSpeed * refillPeriod + range;
-    radioEntry->neighborVector.clear();
+    double radius = getNeighborRadius();
+    std::vector<std::pair<double, const IRadio *>> neighbors;
 
-    for (auto & elem : radios) {
-        const IRadio *otherRadio = elem->radio;
-        Coord otherEntryPosition = otherRadio->getAntenna()->getMobility()->getCurrentPosition();
+    int minX = 0, maxX = 0, minY = 0, maxY = 0;
+    bool singleCell = !std::isfinite(cellSize) || cellSize <= 0;
+    if (!singleCell) {
+        minX = (int)std::floor((radioPosition.x - radius) / cellSize);
+        maxX = (int)std::floor((radioPosition.x + radius) / cellSize);
+        minY = (int)std::floor((radioPosition.y - radius) / cellSize);
+        maxY = (int)std::floor((radioPosition.y + radius) / cellSize);
+    }
+    for (int x = minX; x <= maxX; x++) {
+        for (int y = minY; y <= maxY; y++) {
+            auto it = grid.find(singleCell ? 0 : ((int64_t)x << 32) | (uint32_t)y);
+            if (it == grid.end())
+                continue;
+            for (auto & elem : it->second) {
+                const IRadio *otherRadio = elem->radio;
+                Coord otherEntryPosition = otherRadio->getAntenna()->getMobility()->getCurrentPosition();
 
-        if (otherRadio->getId() != radioEntry->radio->getId() &&
-            otherEntryPosition.sqrdist(radioPosition) <= radius * radius)
-            radioEntry->neighborVector.push_back(otherRadio);
+                if (otherRadio->getId() != radioEntry->radio->getId() &&
+                    otherEntryPosition.sqrdist(radioPosition) <= radius * radius)
+                    neighbors.push_back(std::make_pair(otherEntryPosition.distance(radioPosition), otherRadio));
+            }
+        }
     }
 
+    // equidistant neighbors are ordered by id rather than by address, so the
+    // order of sendToRadio does not depend on the allocator
+    std::sort(neighbors.begin(), neighbors.end(),
+            [] (const std::pair<double, const IRadio *>& a, const std::pair<double, const IRadio *>& b) {
+                return a.first < b.first || (a.first == b.first && a.second->getId() < b.second->getId());
+            });
+    radioEntry->neighborVector.clear();
+    radioEntry->neighborDistances.clear();
+    for (auto & neighbor : neighbors) {
+        radioEntry->neighborDistances.push_back(neighbor.first);
+        radioEntry->neighborVector.push_back(neighbor.second);
+    }
+    updateNeighborCounts(radioEntry);
 }
 
 void LoRaNeighborCache::addRadio(const IRadio *radio)
@@ -109,18 +255,34 @@ void LoRaNeighborCache::addRadio(const IRadio *radio)
     RadioEntry *newEntry = new RadioEntry(radio);
     radios.push_back(newEntry);
     radioToEntry[radio] = newEntry;
-    updateNeighborLists();
     maxSpeed = radioMedium->getMediumLimitCache()->getMaxSpeed().get();
+    // radios registered during initialization are processed in one pass
+    // at INITSTAGE_LINK_LAYER_2, later ones only update the affected lists
+    if (neighborListsBuilt) {
+        if (updateSensitivityRanges() || getNeighborRadius() > cellSize)
+            updateNeighborLists();
+        else {
+            addToGrid(newEntry);
+            updateNeighborList(newEntry);
+            for (size_t i = 0; i < newEntry->neighborVector.size(); i++)
+                insertNeighbor(radioToEntry[newEntry->neighborVector[i]], radio, newEntry->neighborDistances[i]);
+        }
+    }
     if (maxSpeed != 0 && !updateNeighborListsTimer->isScheduled() && initialized())
         scheduleAt(simTime() + refillPeriod, updateNeighborListsTimer);
 }
 
 void LoRaNeighborCache::removeRadio(const IRadio *radio)
 {
-    auto it = find(radios.begin(), radios.end(), radioToEntry[radio]);
+    auto entryIt = radioToEntry.find(radio);
+    auto it = entryIt != radioToEntry.end() ? find(radios.begin(), radios.end(), entryIt->second) : radios.end();
     if (it != radios.end()) {
-        removeRadioFromNeighborLists(radio);
+        RadioEntry *radioEntry = *it;
+        removeRadioFromNeighborLists(radioEntry);
+        removeFromGrid(radioEntry);
         radios.erase(it);
+        radioToEntry.erase(entryIt);
+        delete radioEntry;
         maxSpeed = radioMedium->getMediumLimitCache()->getMaxSpeed().get();
         if (maxSpeed == 0 && initialized())
             cancelEvent(updateNeighborListsTimer);
@@ -133,17 +295,31 @@ void LoRaNeighborCache::removeRadio(const IRadio *radio)
 void LoRaNeighborCache::updateNeighborLists()
 {
     EV_DETAIL << "Updating the neighbor lists" << endl;
+    updateSensitivityRanges();
+    grid.clear();
+    cellSize = getNeighborRadius();
+    for (auto & elem : radios)
+        addToGrid(elem);
     for (auto & elem : radios)
         updateNeighborList(elem);
+    neighborListsBuilt = true;
 }
 
-void LoRaNeighborCache::removeRadioFromNeighborLists(const IRadio *radio)
+void LoRaNeighborCache::removeRadioFromNeighborLists(RadioEntry *radioEntry)
 {
-    for (auto & elem : radios) {
-        Radios neighborVector = elem->neighborVector;
-        auto it = find(neighborVector.begin(), neighborVector.end(), radio);
-        if (it != neighborVector.end())
+    // neighborhood is symmetric, so only the neighbors of the radio refer to it
+    for (auto & neighbor : radioEntry->neighborVector) {
+        auto entryIt = radioToEntry.find(neighbor);
+        if (entryIt == radioToEntry.end())
+            continue;
+        RadioEntry *neighborEntry = entryIt->second;
+        Radios& neighborVector = neighborEntry->neighborVector;
+        auto it = find(neighborVector.begin(), neighborVector.end(), radioEntry->radio);
+        if (it != neighborVector.end()) {
+            neighborEntry->neighborDistances.erase(neighborEntry->neighborDistances.begin() + (it - neighborVector.begin()));
             neighborVector.erase(it);
+            updateNeighborCounts(neighborEntry);
+        }
     }
 }
 
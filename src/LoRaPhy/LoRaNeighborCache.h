@@ -19,7 +19,9 @@
 
 #include "inet/physicallayer/common/packetlevel/RadioMedium.h"
 #include "LoRaPhy/LoRaMedium.h"
+#include "LoRaPhy/LoRaPhyTables.h"
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 namespace inet {
@@ -29,11 +31,25 @@ namespace physicallayer {
 class INET_API LoRaNeighborCache : public cSimpleModule, public INeighborCache
 {
   public:
+    static const int MIN_SPREADING_FACTOR = LoRaPhyTables::MIN_SPREADING_FACTOR;
+    static const int NUM_SPREADING_FACTORS = LoRaPhyTables::NUM_SPREADING_FACTORS;
+    static const int NUM_BANDWIDTHS = LoRaPhyTables::NUM_BANDWIDTHS;
+
     struct RadioEntry
     {
-        RadioEntry(const IRadio *radio) : radio(radio) {};
+        RadioEntry(const IRadio *radio) : radio(radio), cell(0) {};
         const IRadio *radio;
+        /**
+         * Neighbors sorted by increasing distance.
+         */
         std::vector<const IRadio *> neighborVector;
+        std::vector<double> neighborDistances;
+        /**
+         * Number of leading neighbors within the range of each spreading
+         * factor and bandwidth combination.
+         */
+        size_t neighborCounts[NUM_SPREADING_FACTORS][NUM_BANDWIDTHS];
+        int64_t cell;
         bool operator==(RadioEntry *rhs) const
         {
             return this->radio->getId() == rhs->radio->getId();
@@ -42,6 +58,7 @@ class INET_API LoRaNeighborCache : public cSimpleModule, public INeighborCache
     typedef std::vector<RadioEntry *> RadioEntries;
     typedef std::vector<const IRadio *> Radios;
     typedef std::map<const IRadio *, RadioEntry *> RadioEntryCache;
+    typedef std::unordered_map<int64_t, RadioEntries> RadioGrid;
 
   protected:
     LoRaMedium *radioMedium;
@@ -51,14 +68,46 @@ class INET_API LoRaNeighborCache : public cSimpleModule, public INeighborCache
     double refillPeriod;
     double range;
     double maxSpeed;
+    /**
+     * Radio entries bucketed by the cell of their position, the cell size is
+     * the neighbor radius at the time the grid was built.
+     */
+    RadioGrid grid;
+    double cellSize;
+    /**
+     * True once the neighbor lists have been built in bulk, before that
+     * added radios are only registered.
+     */
+    bool neighborListsBuilt;
+    /**
+     * True means frames are only sent to the neighbors that are within the
+     * mean communication range of the frame's spreading factor and bandwidth.
+     */
+    bool splitBySpreadingFactor;
+    W maxTransmissionPower;
+    double shadowingMargin;
+    /**
+     * The mean communication range for each spreading factor and bandwidth,
+     * never bigger than the cache range.
+     */
+    double sensitivityRanges[NUM_SPREADING_FACTORS][NUM_BANDWIDTHS];
 
   protected:
     virtual int numInitStages() const override { return NUM_INIT_STAGES; }
     virtual void initialize(int stage) override;
     virtual void handleMessage(cMessage *msg) override;
+    double getNeighborRadius() const;
+    static int getBandwidthIndex(Hz loRaBW);
+    m computeSensitivityRange(W transmissionPower, W sensitivity) const;
+    bool updateSensitivityRanges();
+    void updateNeighborCounts(RadioEntry *radioEntry);
+    void insertNeighbor(RadioEntry *radioEntry, const IRadio *neighbor, double distance);
+    int64_t getCell(const Coord& position) const;
+    void addToGrid(RadioEntry *radioEntry);
+    void removeFromGrid(RadioEntry *radioEntry);
     void updateNeighborList(RadioEntry *radioEntry);
     void updateNeighborLists();
-    void removeRadioFromNeighborLists(const IRadio *radio);
+    void removeRadioFromNeighborLists(RadioEntry *radioEntry);
 
   public:
     LoRaNeighborCache();
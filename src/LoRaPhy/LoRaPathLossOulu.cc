@@ -42,10 +42,31 @@ double LoRaPathLossOulu::computePathLoss(mps propagationSpeed, Hz frequency, m d
     //EPL = B + 10nlog10( d / d0 )
     //double PL_d0_db = 127.41;
     //double PL_db = PL_d0_db + 10 * gamma * log10(unit(distance / d0).get()) + normal(0.0, sigma);
-    double PL_db = B + 10 * n * log10(unit(distance/d0).get()) - antennaGain + normal(0.0, sigma);
+    double PL_db = computeMeanPathLossDb(distance.get()) + normal(0.0, sigma);
     return math::dB2fraction(-PL_db);
 }
 
+double LoRaPathLossOulu::computeMeanPathLossDb(double distance) const
+{
+    return B + 10 * n * log10(distance / d0.get()) - antennaGain;
+}
+
+double LoRaPathLossOulu::computeMeanPathLoss(m distance) const
+{
+    return math::dB2fraction(-computeMeanPathLossDb(distance.get()));
+}
+
+double LoRaPathLossOulu::computeShadowing() const
+{
+    return math::dB2fraction(-normal(0.0, sigma));
+}
+
+m LoRaPathLossOulu::computeRange(W transmissionPower, W sensitivity) const
+{
+    double PL_db = math::fraction2dB(transmissionPower.get() / sensitivity.get());
+    return d0 * pow(10, (PL_db - B + antennaGain) / (10 * n));
+}
+
 }
 
 }
@@ -17,6 +17,7 @@
 #define LORAPHY_LORAPATHLOSSOULU_H_
 
 #include <inet/physicallayer/pathloss/FreeSpacePathLoss.h>
+#include "LoRaPhy/ILoRaPathLoss.h"
 
 namespace inet {
 
@@ -25,7 +26,7 @@ namespace physicallayer {
 /**
  * This class implements the log normal shadowing model.
  */
-class INET_API LoRaPathLossOulu : public FreeSpacePathLoss
+class INET_API LoRaPathLossOulu : public FreeSpacePathLoss, public ILoRaPathLoss
 {
   protected:
     m d0;
@@ -36,10 +37,15 @@ class INET_API LoRaPathLossOulu : public FreeSpacePathLoss
 
   protected:
     virtual void initialize(int stage) override;
+    double computeMeanPathLossDb(double distance) const;
 
   public:
     LoRaPathLossOulu();
     virtual double computePathLoss(mps propagationSpeed, Hz frequency, m distance) const override;
+    virtual double computeMeanPathLoss(m distance) const override;
+    virtual double computeShadowing() const override;
+    virtual m computeRange(W transmissionPower, W sensitivity) const override;
+    virtual double getShadowingSigma() const override { return sigma; }
 };
 
 } // namespace physicallayer
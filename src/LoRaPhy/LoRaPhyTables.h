@@ -0,0 +1,214 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+// 
+
+#ifndef LORAPHY_LORAPHYTABLES_H_
+#define LORAPHY_LORAPHYTABLES_H_
+
+#include <algorithm>
+
+#include "inet/common/INETDefs.h"
+#include "inet/common/INETMath.h"
+#include "inet/common/Units.h"
+
+namespace inet {
+
+namespace physicallayer {
+
+/**
+ * Tables of the LoRa PHY constants that used to be recomputed or looked up
+ * through if-ladders on every transmission and reception: receiver
+ * sensitivity and background noise (in dBm and converted once to W), symbol
+ * time and time on air. Everything lives in this header so that the MAC,
+ * application and physical layer modules share the very same numbers.
+ */
+namespace LoRaPhyTables {
+
+static const int MIN_SPREADING_FACTOR = 6;
+static const int MAX_SPREADING_FACTOR = 12;
+static const int NUM_SPREADING_FACTORS = MAX_SPREADING_FACTOR - MIN_SPREADING_FACTOR + 1;
+static const int NUM_BANDWIDTHS = 3;
+static const int NUM_PREAMBLE_SYMBOLS = 8;
+
+/** @brief Supported bandwidths, in Hz, in bandwidth index order. */
+constexpr double BANDWIDTHS[NUM_BANDWIDTHS] = { 125000, 250000, 500000 };
+
+/**
+ * @brief Receiver sensitivity in dBm, indexed by [SF - 6][bandwidth index].
+ * Values from Semtech SX1272/73 datasheet, table 10, Rev 3.1, March 2017.
+ */
+constexpr double SENSITIVITY_DBM[NUM_SPREADING_FACTORS][NUM_BANDWIDTHS] = {
+    { -121, -118, -111 },   // SF6
+    { -124, -122, -116 },   // SF7
+    { -127, -125, -119 },   // SF8
+    { -130, -128, -122 },   // SF9
+    { -133, -130, -125 },   // SF10
+    { -135, -132, -128 },   // SF11
+    { -137, -135, -129 },   // SF12
+};
+
+/** @brief Sensitivity used for SF/bandwidth combinations missing from the table. */
+constexpr double DEFAULT_SENSITIVITY_DBM = -126.5;
+
+/**
+ * @brief Symbol time in ms (2^SF / BW[kHz]), indexed by [SF - 6][bandwidth index].
+ */
+constexpr double SYMBOL_TIME_MS[NUM_SPREADING_FACTORS][NUM_BANDWIDTHS] = {
+    { 64 / 125.0, 64 / 250.0, 64 / 500.0 },
+    { 128 / 125.0, 128 / 250.0, 128 / 500.0 },
+    { 256 / 125.0, 256 / 250.0, 256 / 500.0 },
+    { 512 / 125.0, 512 / 250.0, 512 / 500.0 },
+    { 1024 / 125.0, 1024 / 250.0, 1024 / 500.0 },
+    { 2048 / 125.0, 2048 / 250.0, 2048 / 500.0 },
+    { 4096 / 125.0, 4096 / 250.0, 4096 / 500.0 },
+};
+
+/**
+ * @brief Downlink frame the gateway duty cycle back-off is computed for:
+ * 15 bytes sent at 125 kHz with coding rate 4/8.
+ */
+constexpr double GW_DUTY_CYCLE_BANDWIDTH = 125000;
+static const int GW_DUTY_CYCLE_CR = 4;
+static const int GW_DUTY_CYCLE_PAYLOAD_BYTES = 15;
+
+/** @brief The gateway stays silent for this many times the downlink time on air. */
+constexpr double GW_DUTY_CYCLE_AIRTIME_FACTOR = 10;
+
+/** @brief Returns the bandwidth index of loRaBW or -1 if it is not supported. */
+constexpr int getBandwidthIndex(double loRaBW)
+{
+    return loRaBW == BANDWIDTHS[0] ? 0 : loRaBW == BANDWIDTHS[1] ? 1 : loRaBW == BANDWIDTHS[2] ? 2 : -1;
+}
+
+inline int getBandwidthIndex(Hz loRaBW) { return getBandwidthIndex(loRaBW.get()); }
+
+/** @brief Returns the spreading factor index of loRaSF or -1 if it is not supported. */
+constexpr int getSpreadingFactorIndex(int loRaSF)
+{
+    return loRaSF >= MIN_SPREADING_FACTOR && loRaSF <= MAX_SPREADING_FACTOR ? loRaSF - MIN_SPREADING_FACTOR : -1;
+}
+
+/** @brief Returns the receiver sensitivity in dBm for the given SF and bandwidth. */
+inline double getSensitivityDBm(int loRaSF, Hz loRaBW)
+{
+    int sfIndex = getSpreadingFactorIndex(loRaSF);
+    int bwIndex = getBandwidthIndex(loRaBW);
+    return sfIndex >= 0 && bwIndex >= 0 ? SENSITIVITY_DBM[sfIndex][bwIndex] : DEFAULT_SENSITIVITY_DBM;
+}
+
+/** @brief SENSITIVITY_DBM and DEFAULT_SENSITIVITY_DBM converted to W. */
+struct SensitivityTableW
+{
+    double sensitivity[NUM_SPREADING_FACTORS][NUM_BANDWIDTHS];
+    double defaultSensitivity;
+};
+
+/**
+ * @brief Returns the sensitivity table in W. pow() is not constexpr, so the
+ * table is converted on first use, with the same dBm2mW / 1000 arithmetic
+ * the callers used on every reception before.
+ */
+inline const SensitivityTableW& getSensitivityTableW()
+{
+    static const SensitivityTableW table = [] {
+        SensitivityTableW t;
+        for (int i = 0; i < NUM_SPREADING_FACTORS; i++)
+            for (int j = 0; j < NUM_BANDWIDTHS; j++)
+                t.sensitivity[i][j] = math::dBm2mW(SENSITIVITY_DBM[i][j]) / 1000;
+        t.defaultSensitivity = math::dBm2mW(DEFAULT_SENSITIVITY_DBM) / 1000;
+        return t;
+    }();
+    return table;
+}
+
+/** @brief Returns the receiver sensitivity for the given SF and bandwidth. */
+inline W getSensitivity(int loRaSF, Hz loRaBW)
+{
+    const SensitivityTableW& table = getSensitivityTableW();
+    int sfIndex = getSpreadingFactorIndex(loRaSF);
+    int bwIndex = getBandwidthIndex(loRaBW);
+    return W(sfIndex >= 0 && bwIndex >= 0 ? table.sensitivity[sfIndex][bwIndex] : table.defaultSensitivity);
+}
+
+/**
+ * @brief Returns the background noise power for the given SF and bandwidth.
+ * The analog model takes the receiver sensitivity as the noise floor, so
+ * this is the sensitivity table.
+ */
+inline W getBackgroundNoisePower(int loRaSF, Hz loRaBW)
+{
+    return getSensitivity(loRaSF, loRaBW);
+}
+
+/** @brief Returns the symbol time in ms for the given SF and bandwidth. */
+inline double getSymbolTime(int loRaSF, Hz loRaBW)
+{
+    int sfIndex = getSpreadingFactorIndex(loRaSF);
+    int bwIndex = getBandwidthIndex(loRaBW);
+    if (sfIndex >= 0 && bwIndex >= 0)
+        return SYMBOL_TIME_MS[sfIndex][bwIndex];
+    else
+        return pow(2, loRaSF) / (loRaBW.get() / 1000);
+}
+
+/**
+ * @brief Returns the number of payload symbols. The division is an integer
+ * division on purpose, as in the original time on air computation.
+ */
+inline int getPayloadSymbolCount(int payloadBytes, int loRaSF, int loRaCR)
+{
+    return 8 + std::max((8 * payloadBytes - 4 * loRaSF + 28 + 16) / (4 * loRaSF) * (loRaCR + 4), 0);
+}
+
+/** @brief Time on air of a LoRa frame, split in its three parts. */
+struct Airtime
+{
+    simtime_t preamble;
+    simtime_t header;
+    simtime_t payload;
+
+    simtime_t getDuration() const { return preamble + header + payload; }
+};
+
+/** @brief Computes the time on air of a frame with payloadBytes bytes. */
+inline Airtime computeAirtime(int loRaSF, Hz loRaBW, int loRaCR, int payloadBytes)
+{
+    Airtime airtime;
+    simtime_t Tsym = getSymbolTime(loRaSF, loRaBW);
+    airtime.preamble = (NUM_PREAMBLE_SYMBOLS + 4.25) * Tsym / 1000;
+    int payloadSymbNb = getPayloadSymbolCount(payloadBytes, loRaSF, loRaCR);
+    airtime.header = 0.5 * (8 + payloadSymbNb) * Tsym / 1000;
+    airtime.payload = airtime.header;
+    return airtime;
+}
+
+/**
+ * @brief Returns the gateway duty cycle back-off after a downlink sent at
+ * loRaSF. For SF7 to SF12 this gives the 0.61696, 1.23392, 2.14016, 4.28032,
+ * 7.24992 and 14.49984 s the gateway MACs used to hard-code.
+ */
+inline simtime_t getGatewayDutyCycleDelta(int loRaSF)
+{
+    if (loRaSF < 7 || loRaSF > MAX_SPREADING_FACTOR)
+        throw cRuntimeError("Unsupported spreading factor for the gateway duty cycle: %d", loRaSF);
+    return GW_DUTY_CYCLE_AIRTIME_FACTOR * computeAirtime(loRaSF, Hz(GW_DUTY_CYCLE_BANDWIDTH), GW_DUTY_CYCLE_CR, GW_DUTY_CYCLE_PAYLOAD_BYTES).getDuration();
+}
+
+} // namespace LoRaPhyTables
+
+} // namespace physicallayer
+
+} // namespace inet
+
+#endif /* LORAPHY_LORAPHYTABLES_H_ */
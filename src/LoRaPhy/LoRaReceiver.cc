@@ -15,6 +15,7 @@
 
 #include "LoRaReceiver.h"
 #include "inet/physicallayer/analogmodel/packetlevel/ScalarNoise.h"
+#include "LoRaPhyTables.h"
 
 namespace inet {
 
@@ -130,65 +131,46 @@ bool LoRaReceiver::isPacketCollided(const IReception *reception, IRadioSignal::S
     W signalRSSI_w = loRaReception->getPower();
     double signalRSSI_mw = signalRSSI_w.get()*1000;
     double signalRSSI_dBm = math::mW2dBm(signalRSSI_mw);
+    Hz signalCF = loRaReception->getLoRaCF();
+    int signalSF = loRaReception->getLoRaSF();
+
+    double nPreamble = 8; //from the paper "Does Lora networks..."
+    //double Npream = nPreamble + 4.25; //4.25 is a constant added by Lora Transceiver
+
+    simtime_t Tsym = LoRaPhyTables::getSymbolTime(signalSF, loRaReception->getLoRaBW())/1000;
+    simtime_t csBegin = loRaReception->getPreambleStartTime() + Tsym * (nPreamble - 5);
+
     for (auto interferingReception : *interferingReceptions) {
-        bool overlap = false;
-        bool frequencyColision = false;
-        bool spreadingFactorColision = false;
-        bool captureEffect = false;
-        bool timingCollison = false; //Collision is acceptable in first part of preambles
         const LoRaReception *loRaInterference = check_and_cast<const LoRaReception *>(interferingReception);
 
+        // only receptions on the same carrier frequency and spreading factor can
+        // collide. The interference isn't bucketed by (CF, SF) when it's built,
+        // because LoRaAnalogModel::computeNoise needs the interferers of every
+        // SF on the listening channel
+        if (loRaInterference->getLoRaCF() != signalCF || loRaInterference->getLoRaSF() != signalSF)
+            continue;
+
         simtime_t m_y = (loRaInterference->getStartTime() + loRaInterference->getEndTime())/2;
         simtime_t d_y = (loRaInterference->getEndTime() - loRaInterference->getStartTime())/2;
-        if(omnetpp::fabs(m_x - m_y) < d_x + d_y)
-        {
-            overlap = true;
-        }
+        if(omnetpp::fabs(m_x - m_y) >= d_x + d_y)
+            continue;
 
-        if(loRaReception->getLoRaCF() == loRaInterference->getLoRaCF())
+        if(alohaChannelModel == true)
         {
-            frequencyColision = true;
-        }
-
-        if(loRaReception->getLoRaSF() == loRaInterference->getLoRaSF())
-        {
-            spreadingFactorColision = true;
+            if(iAmGateway && (part == IRadioSignal::SIGNAL_PART_DATA || part == IRadioSignal::SIGNAL_PART_WHOLE)) const_cast<LoRaReceiver* >(this)->emit(LoRaReceptionCollision, true);
+            return true;
         }
 
         W interferenceRSSI_w = loRaInterference->getPower();
         double interferenceRSSI_mw = interferenceRSSI_w.get()*1000;
         double interferenceRSSI_dBm = math::mW2dBm(interferenceRSSI_mw);
 
-        if(signalRSSI_dBm - interferenceRSSI_dBm < P_threshold)
+        bool captureEffect = signalRSSI_dBm - interferenceRSSI_dBm < P_threshold;
+        bool timingCollison = csBegin < loRaInterference->getEndTime(); //Collision is acceptable in first part of preambles
+        if(captureEffect && timingCollison)
         {
-            captureEffect = true;
-        }
-
-        double nPreamble = 8; //from the paper "Does Lora networks..."
-        //double Npream = nPreamble + 4.25; //4.25 is a constant added by Lora Transceiver
-
-        simtime_t Tsym = (pow(2, loRaReception->getLoRaSF()))/(loRaReception->getLoRaBW().get()/1000)/1000;
-        simtime_t csBegin = loRaReception->getPreambleStartTime() + Tsym * (nPreamble - 5);
-        if(csBegin < loRaInterference->getEndTime())
-        {
-            timingCollison = true;
-        }
-        if (overlap && frequencyColision && spreadingFactorColision) // && captureEffect && timingCollison)
-        {
-            if(alohaChannelModel == true)
-            {
-                if(iAmGateway && (part == IRadioSignal::SIGNAL_PART_DATA || part == IRadioSignal::SIGNAL_PART_WHOLE)) const_cast<LoRaReceiver* >(this)->emit(LoRaReceptionCollision, true);
-                return true;
-            }
-            if(alohaChannelModel == false)
-            {
-                if(captureEffect && timingCollison)
-                {
-                    if(iAmGateway && (part == IRadioSignal::SIGNAL_PART_DATA || part == IRadioSignal::SIGNAL_PART_WHOLE)) const_cast<LoRaReceiver* >(this)->emit(LoRaReceptionCollision, true);
-                    return true;
-                }
-            }
-
+            if(iAmGateway && (part == IRadioSignal::SIGNAL_PART_DATA || part == IRadioSignal::SIGNAL_PART_WHOLE)) const_cast<LoRaReceiver* >(this)->emit(LoRaReceptionCollision, true);
+            return true;
         }
     }
     return false;
@@ -264,10 +246,6 @@ const IListeningDecision *LoRaReceiver::computeListeningDecision(const IListenin
 
 W LoRaReceiver::getSensitivity(const LoRaReception *reception) const
 {
-    //function returns sensitivity -- according to LoRa documentation, it changes with LoRa parameters
-    //Sensitivity values from Semtech SX1272/73 datasheet, table 10, Rev 3.1, March 2017
-    W sensitivity = W(math::dBm2mW(-126.5) / 1000);
-
     // When CAD (channel activity detection) is used to automatically switch the receiver to the
     // appropriate SF the incoming transmission is using (this is implemented in different
     // projects (e.g. Single Channel LoRaWAN Gateway https://github.com/things4u/ESP-1ch-Gateway),
@@ -283,50 +261,16 @@ W LoRaReceiver::getSensitivity(const LoRaReception *reception) const
         loRaCADatt = loRaApp->loRaCADatt;
     }
 
-    if(reception->getLoRaSF() == 6)
-    {
-        if(reception->getLoRaBW() == Hz(125000)) sensitivity = W(math::dBm2mW(-121 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(250000)) sensitivity = W(math::dBm2mW(-118 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(500000)) sensitivity = W(math::dBm2mW(-111 + loRaCADatt) / 1000);
-    }
-    else if (reception->getLoRaSF() == 7)
-    {
-        if(reception->getLoRaBW() == Hz(125000)) sensitivity = W(math::dBm2mW(-124 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(250000)) sensitivity = W(math::dBm2mW(-122 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(500000)) sensitivity = W(math::dBm2mW(-116 + loRaCADatt) / 1000);
-    }
-    else if(reception->getLoRaSF() == 8)
-    {
-        if(reception->getLoRaBW() == Hz(125000)) sensitivity = W(math::dBm2mW(-127 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(250000)) sensitivity = W(math::dBm2mW(-125 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(500000)) sensitivity = W(math::dBm2mW(-119 + loRaCADatt) / 1000);
-    }
-    else if(reception->getLoRaSF() == 9)
-    {
-        if(reception->getLoRaBW() == Hz(125000)) sensitivity = W(math::dBm2mW(-130 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(250000)) sensitivity = W(math::dBm2mW(-128 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(500000)) sensitivity = W(math::dBm2mW(-122 + loRaCADatt) / 1000);
-    }
-    else if(reception->getLoRaSF() == 10)
-    {
-        if(reception->getLoRaBW() == Hz(125000)) sensitivity = W(math::dBm2mW(-133 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(250000)) sensitivity = W(math::dBm2mW(-130 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(500000)) sensitivity = W(math::dBm2mW(-125 + loRaCADatt) / 1000);
-    }
-    else if(reception->getLoRaSF() == 11)
-    {
-        if(reception->getLoRaBW() == Hz(125000)) sensitivity = W(math::dBm2mW(-135 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(250000)) sensitivity = W(math::dBm2mW(-132 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(500000)) sensitivity = W(math::dBm2mW(-128 + loRaCADatt) / 1000);
-    }
-    else if(reception->getLoRaSF() == 12)
-    {
-        if(reception->getLoRaBW() == Hz(125000)) sensitivity = W(math::dBm2mW(-137 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(250000)) sensitivity = W(math::dBm2mW(-135 + loRaCADatt) / 1000);
-        else if(reception->getLoRaBW() == Hz(500000)) sensitivity = W(math::dBm2mW(-129 + loRaCADatt) / 1000);
-    }
+    return getSensitivity(reception->getLoRaSF(), reception->getLoRaBW(), loRaCADatt);
+}
 
-    return sensitivity;
+W LoRaReceiver::getSensitivity(int loRaSF, Hz loRaBW, double loRaCADatt)
+{
+    //function returns sensitivity -- according to LoRa documentation, it changes with LoRa parameters
+    if (loRaCADatt == 0)
+        return LoRaPhyTables::getSensitivity(loRaSF, loRaBW);
+    else
+        return W(math::dBm2mW(LoRaPhyTables::getSensitivityDBm(loRaSF, loRaBW) + loRaCADatt) / 1000);
 }
 
 }
@@ -94,6 +94,12 @@ public:
 
   W getSensitivity(const LoRaReception *loRaReception) const;
 
+  /**
+   * Returns the datasheet sensitivity for the given spreading factor and
+   * bandwidth, increased by the given CAD attenuation in dB.
+   */
+  static W getSensitivity(int loRaSF, Hz loRaBW, double loRaCADatt = 0);
+
   bool isPacketCollided(const IReception *reception, IRadioSignal::SignalPart part, const IInterference *interference) const;
 
   virtual void setLoRaTP(W newTP) { LoRaTP = newTP; };
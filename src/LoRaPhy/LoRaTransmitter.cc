@@ -16,6 +16,7 @@
 #include "LoRaTransmitter.h"
 #include "inet/physicallayer/analogmodel/packetlevel/ScalarTransmission.h"
 #include "LoRaModulation.h"
+#include "LoRaPhyTables.h"
 
 namespace inet {
 
@@ -66,11 +67,6 @@ const ITransmission *LoRaTransmitter::createTransmission(const IRadio *transmitt
     const_cast<LoRaTransmitter* >(this)->emit(LoRaTransmissionCreated, true);
     const LoRaMacFrame *frame = check_and_cast<const LoRaMacFrame *>(macFrame);
 
-    int nPreamble = 8;
-    simtime_t Tsym = (pow(2, frame->getLoRaSF()))/(frame->getLoRaBW().get()/1000);
-    simtime_t Tpreamble = (nPreamble + 4.25) * Tsym / 1000;
-
-    //preambleDuration = Tpreamble;
     int payloadBytes = 0;
     if(iAmGateway) payloadBytes = 15;
     else payloadBytes = 20;
@@ -79,12 +75,12 @@ const ITransmission *LoRaTransmitter::createTransmission(const IRadio *transmitt
         payloadBytes = frame->getByteLength();
     }
 
-    int payloadSymbNb = 8 + math::max(ceil((8*payloadBytes - 4*frame->getLoRaSF() + 28 + 16 - 20*0)/(4*(frame->getLoRaSF()-2*0)))*(frame->getLoRaCR() + 4), 0);
-
-    simtime_t Theader = 0.5 * (8+payloadSymbNb) * Tsym / 1000;
-    simtime_t Tpayload = 0.5 * (8+payloadSymbNb) * Tsym / 1000;
+    const LoRaPhyTables::Airtime airtime = LoRaPhyTables::computeAirtime(frame->getLoRaSF(), frame->getLoRaBW(), frame->getLoRaCR(), payloadBytes);
+    const simtime_t Tpreamble = airtime.preamble;
+    const simtime_t Theader = airtime.header;
+    const simtime_t Tpayload = airtime.payload;
 
-    const simtime_t duration = Tpreamble + Theader + Tpayload;
+    const simtime_t duration = airtime.getDuration();
     const simtime_t endTime = startTime + duration;
 
     IMobility *mobility = transmitter->getAntenna()->getMobility();
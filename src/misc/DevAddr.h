@@ -18,6 +18,7 @@
 #ifndef __INET_DEVADDR_H
 #define __INET_DEVADDR_H
 
+#include <functional>
 #include <string>
 
 #include "inet/common/INETDefs.h"
@@ -183,5 +184,18 @@ inline std::ostream& operator<<(std::ostream& os, const DevAddr& mac)
 
 } // namespace inet
 
+namespace std {
+
+/**
+ * Allows DevAddr keys in unordered containers.
+ */
+template<>
+struct hash<inet::DevAddr>
+{
+    size_t operator()(const inet::DevAddr& addr) const { return hash<inet::uint64>()(addr.getInt()); }
+};
+
+} // namespace std
+
 #endif // ifndef __INET_DEVADDR_H
 